@@ -0,0 +1,55 @@
+#ifndef _CLIPPING_H_
+#define _CLIPPING_H_
+
+// SSE2 is always available on x64 and can be enabled for x86
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CLIPPING_SSE2
+#endif
+
+#include <vector>
+#include <limits>
+#include "..\\header\\types.h"
+
+namespace clipping
+{
+	// Outcode bits of a point relative to a tile, tiles are closed so points on the border are inside
+	enum Outcode {
+		out_none = 0,
+		out_left = 1,
+		out_right = 2,
+		out_bottom = 4,
+		out_top = 8
+	};
+
+	// Clipped vertex, generated vertices have no node index
+	class Vertex
+	{
+	public:
+
+		Vertex();
+		Vertex(double latitude, double longitude, size_t i);
+
+		bool IsGenerated();
+
+		double lat, lon;
+		size_t index;
+	};
+
+	// Computes the outcodes of count points given as separate lat and lon arrays
+	void Classify(const double *lat, const double *lon, size_t count, types::Tile &tile, unsigned char *codes);
+	unsigned char Classify(double lat, double lon, types::Tile &tile);
+
+	// Liang-Barsky, returns the parameters of the part of the segment that lies inside the tile
+	// or false if the segment misses the tile
+	bool ClipSegment(double lat0, double lon0, double lat1, double lon1, types::Tile &tile, double &t0, double &t1);
+
+	// Sutherland-Hodgman, clips a ring without its closing vertex against the tile
+	void ClipRing(std::vector<clipping::Vertex> &ring, types::Tile &tile, std::vector<clipping::Vertex> &result);
+	double RingArea(std::vector<clipping::Vertex> &ring);
+
+	// Appends the parameters at which the segment from start to end crosses one of the
+	// inner lines of a uniform grid with the given origin, spacing and number of cells
+	void GridCrossings(double start, double end, double origin, double step, size_t cells, std::vector<double> &result);
+}
+
+#endif /* _CLIPPING_H_ */
@@ -12,9 +12,38 @@
 
 #define C_MAX_LOD (short)15
 #define C_MIN_LOD (short)0
-
-#define VERSION_MAJOR 1
-#define VERSION_MINOR 0
+// Finest LoD at which same-type areas are dissolved into each other
+#define C_DISSOLVE_LOD (short)10
+// Finest LoD at which connected same-type lines are merged into one
+#define C_MERGE_LINE_LOD (short)12
+// LoDs at which buildings are aggregated into blocks
+#define C_BLOCK_MIN_LOD (short)10
+#define C_BLOCK_MAX_LOD (short)13
+// Coarsest LoD that contains single objects and the number of cluster cells per tile side
+#define C_CLUSTER_MIN_LOD (short)12
+#define C_CLUSTER_CELLS (size_t)32
+// Coarsest LoDs whose landcover can be generalized on a raster and the largest raster side
+#define C_RASTER_MAX_LOD (short)2
+#define C_RASTER_MAX_CELLS (size_t)4096
+// Areas whose extent is below this fraction of a tile side may be replaced by their hull
+#define C_HULL_FRACTION 16.0
+// Tiles per thread that are encoded before they are written
+#define C_ENCODE_TILES (size_t)8
+// Coordinates are quantized to this fraction of a tile side, but not finer than OSM's precision
+#define C_QUANT_STEPS 65536.0
+#define C_QUANT_MIN 0.0000001
+// Byte size of the lookup header and of one lookup entry (offset and length of a tile)
+#define C_LOOKUP_HEADER (size_t)96
+#define C_LOOKUP_STRIDE (size_t)16
+// Objects of a tile are split into this many tiers of falling importance
+#define C_IMPORTANCE_TIERS 4
+// Number of types::Layer groups, every layer of a tile holds its own tiers
+#define C_TILE_LAYERS 6
+// Sections of a tile in a segment: ways, relations and shared references per layer and tier
+#define C_TILE_SECTIONS (C_TILE_LAYERS * C_IMPORTANCE_TIERS * 3)
+
+#define VERSION_MAJOR 2
+#define VERSION_MINOR 5
 #define VERSION_PATCH 0
 
 ///////////////////////////////////////////////////////
@@ -27,6 +56,10 @@
 #include <queue>
 #include <array>
 #include <functional>
+#include <map>
+#include <tuple>
+#include <cstring>
+#include <memory>
 //#include <AccCtrl.h>
 
 ///////////////////////////////////////////////////////
@@ -40,6 +73,11 @@
 ///////////////////////////////////////////////////////
 #include "..\\header\\utility.h"
 #include "..\\header\\mathtools.h"
+#include "..\\header\\spatial.h"
+#include "..\\header\\simplification.h"
+#include "..\\header\\clipping.h"
+#include "..\\header\\serializer.h"
+#include "..\\header\\threadpool.h"
 
 using namespace google::protobuf;
 
@@ -89,9 +127,15 @@ namespace osmconverter {
 
 		void ConvertPBF();
 
-		void SetParameters(string in, string out, bool, bool, logging::LogLvl, size_t[16], types::Sorting);
+		void SetParameters(string in, string out, bool, bool, logging::LogLvl, size_t[16], types::Sorting, types::Simplification[16], size_t, size_t, size_t, int[16], types::Importance);
 		void SetSorting(types::Sorting);
+		void SetShareThreshold(size_t);
+		void SetRasterSize(size_t);
+		void SetHullLoDs(size_t);
+		void SetImportance(types::Importance);
 		void SetLoDs(size_t[16]);
+		void SetSimplification(types::Simplification[16]);
+		void SetCompression(int[16]);
 		void SetLoggingLevel(logging::LogLvl);
 
 	private:
@@ -145,6 +189,61 @@ namespace osmconverter {
 			size_t index;
 		};
 
+		// Non-empty section of a tile, the slot numbers its tier, layer and object section as
+		// (tier * C_TILE_LAYERS + layer) * 3 + section so sections sort in storage order.
+		// Tiles are stored tier by tier, every tier layer by layer and every layer holds ways,
+		// relations and shared references
+		class TileSection {
+		public:
+			size_t slot, count;
+			long long length;
+		};
+
+		// Stored tile of a segment file, the offset of its payload and its non-empty sections
+		class SegmentTile {
+		public:
+			long long start;
+			std::vector<TileSection> sections;
+		};
+
+		// Reads the tiles of a segment in tile order, only the next stored tile is held in memory
+		class SegmentCursor {
+		public:
+			serializer::Reader reader;
+			// Index of the tile held in tile and the index following the last tile read
+			size_t next, after;
+			SegmentTile tile;
+		};
+
+		// Header of a merged tile, only sections that hold objects are listed so readers can seek
+		// to a layer and stop after any of its tiers
+		class TileHeader {
+		public:
+			std::vector<TileSection> sections;
+		};
+
+		// Kinds of objects a tile references, the first four are written to the ways section,
+		// the next two to the relations section and the rest to the shared references section
+		enum ObjectKind {
+			kind_point_group,
+			kind_way,
+			kind_piece,
+			kind_wayx,
+			kind_relation,
+			kind_relationx,
+			kind_shared_way,
+			kind_shared_relation
+		};
+
+		// Object of a tile and the keys it is ordered by when the tile is written
+		class TileObject {
+		public:
+			ObjectKind kind;
+			types::Layer layer;
+			size_t index;
+			double key, tie;
+		};
+
 		///////////////////////////////////////////////////////
 		// Private Functions
 		///////////////////////////////////////////////////////
@@ -178,6 +277,11 @@ namespace osmconverter {
 
 		// Tile-Membership
 		size_t FindTile(size_t object_index, types::Member mem);
+		size_t TileIndexAt(double lat, double lon);
+		void TouchedTiles(types::Way&, std::vector<size_t> &tiles);
+		void RelationBox(types::Relation&, spatial::Box&, short depth);
+		bool ShareWay(size_t index);
+		bool ShareRelation(size_t index);
 		void GetLatLonForSearch(size_t object_index, types::Member mem, double &lat, double &lon);
 
 		// Overflow flag
@@ -189,27 +293,57 @@ namespace osmconverter {
 
 		// Data-Output
 		void WriteDataToFile(short);
-		void UpdateDatabase(short);
-		void TransferRelation(FILE *from, FILE *to);
-		void TransferMemberRelation(FILE *from, FILE *to, size_t size);
-		void WriteNode(FILE*, size_t, bool);
-		void WriteWay(FILE*, size_t, bool);
-		void WriteWayX(FILE*, size_t, bool);
-		void WriteRelation(FILE*, size_t, bool);
-		void WriteMemberWay(FILE*, size_t, bool);
-		void WriteMemberRelation(FILE*, size_t, bool);
-		void WriteRelationX(FILE*, size_t, bool);
-		void WriteXMemberWay(FILE*, size_t, size_t, bool);
-		void WriteXMemberRelation(FILE*, size_t, size_t, bool);
+		void EncodeTile(serializer::Buffer&, size_t, SegmentTile&);
+		void OrderTile(types::Tile&, std::vector<TileObject>&);
+		void EncodeObject(serializer::Buffer&, types::Tile&, TileObject&);
+		void WriteSharedObjects(short);
+		void FinishSegment(short);
+		void MergeSegments(short);
+		void ReadSegmentTile(SegmentCursor&);
+		void MergeTileHeader(TileHeader&, size_t, std::vector<std::vector<SegmentTile>>&);
+		void AssembleTile(serializer::Buffer&, size_t, TileHeader&, std::vector<FILE*>&, std::vector<std::vector<SegmentTile>>&);
+		void CompressTile(serializer::Buffer&, serializer::Buffer&, int);
+
+		// Binary encoding
+		double GetQuantum(double);
+		void EncodeNode(serializer::Buffer&, size_t);
+		void EncodeWay(serializer::Buffer&, types::Way&);
+		void EncodeWayX(serializer::Buffer&, size_t);
+		void EncodePointGroup(serializer::Buffer&, types::PointGroup&);
+		void EncodeRelation(serializer::Buffer&, size_t);
+		void EncodeMembers(serializer::Buffer&, size_t);
+		void EncodeMemberWay(serializer::Buffer&, size_t);
+		void EncodeMemberRelation(serializer::Buffer&, size_t);
+		void EncodeRelationX(serializer::Buffer&, size_t);
+		void EncodeXMemberWay(serializer::Buffer&, size_t, size_t);
+		void EncodeXMemberRelation(serializer::Buffer&, size_t, size_t);
+
+		// Text output for debugging
+		void WriteNode(FILE*, size_t);
+		void WriteWay(FILE*, types::Way&);
+		void WriteWayX(FILE*, size_t);
+		void WritePointGroup(FILE*, types::PointGroup&);
+		void WriteRelation(FILE*, size_t);
+		void WriteMemberWay(FILE*, size_t);
+		void WriteMemberRelation(FILE*, size_t);
+		void WriteRelationX(FILE*, size_t);
+		void WriteXMemberWay(FILE*, size_t, size_t);
+		void WriteXMemberRelation(FILE*, size_t, size_t);
 
 		// Filenames
 		string GetDataFilename(short lod);
 		string GetLookupFilename(short lod);
+		string GetSharedFilename(short lod);
+		string GetSegmentFilename(short lod, size_t segment);
 
 		// Data Generalization
 		size_t SubdivideLine(types::Tile&, types::Way&);
 		size_t SubdivideArea(types::Tile&, types::Way&);
 		size_t Subdivide(types::Tile&, types::Way&, bool);
+		void ClipToTiles(size_t index);
+		size_t ClipWay(size_t index, std::vector<size_t> &tiles);
+		void ClipLine(types::Way&, std::vector<std::vector<size_t>> &pieces, std::vector<size_t> &tiles);
+		void ClipArea(types::Way&, std::vector<std::vector<size_t>> &pieces, std::vector<size_t> &tiles);
 
 		bool MergeAreas(short lod, types::Way &at, types::Way &other, std::vector<size_t>&);
 		WayOrientation GetWayOrientation(Extrema[4], Extrema[4]);
@@ -217,19 +351,54 @@ namespace osmconverter {
 		void GetNewExtrema(Converter::WayOrientation o, Converter::Extrema &one, types::Way &wone, Converter::Extrema &two, types::Way &wtwo);
 		std::vector<size_t> Merge(std::vector<size_t> &first, std::vector<size_t> &second, size_t onemin, size_t onemax, size_t twomin, size_t twomax);
 
-		void ConstructConvexHull(std::vector<size_t> &points, size_t index);
-		double IsLeft(size_t start, size_t end, size_t at);
+		// Line Merging
+		bool IsMergeLineType(types::Type);
+		void MarkRelationMembers(std::vector<bool>&, size_t count);
+		void MergeLines(short lod, std::vector<types::Way>&);
+
+		// Building Aggregation
+		void AggregateBuildings(short lod);
+
+		// Raster Generalization
+		bool IsRasterType(types::Type);
+		void RasterizeAreas(short lod);
+		void RasterizeRing(std::vector<size_t>&, std::vector<unsigned char> &grid, size_t cells, double lat_cell, double lon_cell);
+		void SmoothRaster(std::vector<unsigned char> &grid, size_t cells);
+		void FillRasterHoles(std::vector<unsigned char> &grid, size_t cells);
+		void TraceRaster(std::vector<unsigned char> &grid, size_t cells, double lat_cell, double lon_cell, std::vector<std::vector<size_t>> &rings);
+
+		// Area Dissolving
+		bool IsDissolveType(types::Type);
+		void DissolveAreas(short lod, std::vector<types::Way>&);
+		std::vector<std::vector<size_t>> UnionAreas(std::vector<types::Way>&, std::vector<size_t> &cluster, double tolerance);
+		size_t SnapNode(size_t index, double tolerance, std::unordered_map<long long, std::vector<size_t>> &snap);
+		double SegmentPosition(size_t start, size_t end, size_t at, double &distance);
+		double RingOrientation(std::vector<size_t>&);
+		bool IsInsideRing(double lat, double lon, std::vector<size_t>&);
 
-		std::vector<size_t> DouglasPeucker(std::vector<size_t>, double);
-		std::vector<size_t> VisvalingamWhyatt(std::vector<size_t>&, size_t);
-		double PerpendicularDistance(std::vector<size_t> &polygon, size_t current);
+		void ConstructConvexHull(std::vector<size_t> &points, size_t index);
+		void HullAreas(short lod);
+
+		// Vertex ranking shared by all LoDs
+		void RankWays();
+		// Borders shared by several areas are simplified once
+		void BuildSharedBorders();
+		void SimplifyBorders(short lod);
+		void AssembleBorders(std::vector<std::pair<size_t, bool>>&, std::vector<size_t> &refs);
+		// Simplification with the algorithm chosen for the LoD
+		void SimplifyWay(short lod, types::Way&);
+		template<class Algorithm> void ApplySimplification(short lod, types::Way&);
 
 		bool IsLoDType(short, types::Type);
 		double GetLoDEpsilon(short);
 		double GetLoDAreaSize(short);
 		size_t GetLoDPercentage(short, size_t);
 
+		// Single Object Clustering
+		void SortSingles(short lod);
+
 		// Way Generalization
+		void BuildAreaGrid(short lod, std::vector<types::Way>&);
 		void GeneralizeWays(std::vector<types::Way>&, size_t, short);
 		void SortWays(short lod, std::vector<types::Way>&);
 
@@ -259,12 +428,32 @@ namespace osmconverter {
 		size_t m_way_count, m_relation_count, m_tilecount;
 		// LoD tile number roots
 		size_t m_lods[16];
+		// Line simplification algorithm per LoD
+		types::Simplification m_simplify[16];
+		// zlib level of the tiles per LoD, 0 stores them raw
+		int m_compress[16];
+		// Key the objects of a tile are ordered by
+		types::Importance m_importance;
 		// Input and output locations
 		std::string m_input, m_output;
 		// Flags
-		bool m_debug, m_line, m_overflow, m_update, m_read_type[3];
+		bool m_debug, m_line, m_overflow, m_read_type[3];
 		// Sorting
 		types::Sorting m_sort;
+		// Minimum number of tiles an object has to span to be stored in the shared section, 0 disables it
+		size_t m_share;
+		// Raster cells per tile side, 0 if raster generalization is off
+		size_t m_raster;
+		// Number of coarsest LoDs at which small areas are replaced by their convex hull
+		size_t m_hull;
+		// Tiles of the LoD segment being written and number of finished reading batches
+		size_t m_segment_tiles, m_segment_count;
+		// Index following the last tile stored in the LoD segment being written, empty tiles are left out
+		size_t m_segment_stored;
+		// Reused for encoding tiles before they are written
+		serializer::Buffer m_buffer;
+		// Worker threads that encode and merge tiles, started once for the whole conversion
+		std::unique_ptr<threadpool::ThreadPool> m_pool;
 		// Current tile's lat and lon step
 		double m_lat_step, m_lon_step;
 		// Bounding Box
@@ -294,6 +483,21 @@ namespace osmconverter {
 
 		// All tiles of the current LoD
 		std::vector<types::Tile> m_tiles;
+		// Offsets of the objects already written to the current LoD's shared file
+		std::unordered_map<size_t, long long> m_shared_ways, m_shared_relations;
+
+		// Pieces of the ways clipped for the tiles that are currently written, ways keep their references
+		std::vector<types::Way> m_pieces;
+
+		// Border chains between junction nodes and the chains every area is made of,
+		// a chain is reversed if the flag is set
+		std::vector<types::Way> m_chains;
+		std::unordered_map<size_t, std::vector<std::pair<size_t, bool>>> m_borders;
+
+		// Areas that can be merged at the current LoD
+		spatial::Grid m_area_grid;
+		// Nodes created by grid snapping at the current LoD by grid cell
+		std::unordered_map<long long, size_t> m_snapped;
 	};
 }
 
@@ -0,0 +1,43 @@
+#ifndef _KERNELS_H_
+#define _KERNELS_H_
+
+// AVX2 code is compiled for x86 and x64 and only called if the cpu supports it
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define KERNELS_AVX2
+#define KERNELS_TARGET_AVX2
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KERNELS_AVX2
+#define KERNELS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#include <cstddef>
+
+namespace kernels
+{
+	// Instruction set used by the batch functions, detected once at runtime
+	enum Level {
+		scalar,
+		avx2
+	};
+
+	Level GetLevel();
+
+	// Distances of count points given as separate x and y arrays to the line through start and end,
+	// if start and end are identical the distance to start is used
+	void SegmentDistances(const double *x, const double *y, size_t count, double sx, double sy, double ex, double ey, double *result);
+
+	// Areas of the triangles formed by every three consecutive points, result[i] belongs to the
+	// triangle of the points i, i + 1 and i + 2 so count - 2 values are written
+	void TriangleAreas(const double *x, const double *y, size_t count, double *result);
+
+	// Scalar versions, also used for the leftover points of the vectorized versions
+	void SegmentDistancesScalar(const double *x, const double *y, size_t count, double sx, double sy, double ex, double ey, double *result);
+	void TriangleAreasScalar(const double *x, const double *y, size_t count, double *result);
+
+#ifdef KERNELS_AVX2
+	void SegmentDistancesAVX2(const double *x, const double *y, size_t count, double sx, double sy, double ex, double ey, double *result);
+	void TriangleAreasAVX2(const double *x, const double *y, size_t count, double *result);
+#endif
+}
+
+#endif /* _KERNELS_H_ */
@@ -60,6 +60,33 @@ namespace mathtools
 		static double Area(vec2, vec2, vec2);
 	};
 
+	// Min-heap of triangles that can be addressed by triangle index,
+	// so the area of a triangle can be changed after it was pushed
+	class TriangleHeap {
+	public:
+
+		TriangleHeap();
+		TriangleHeap(size_t count);
+
+		bool Empty();
+		size_t Size();
+		bool Contains(size_t index);
+
+		void Push(triangle t);
+		triangle Pop();
+		void Update(size_t index, double area);
+
+	private:
+
+		void SiftUp(size_t pos);
+		void SiftDown(size_t pos);
+		void Swap(size_t a, size_t b);
+
+		std::vector<triangle> m_heap;
+		// Position of each triangle index inside the heap
+		std::vector<size_t> m_position;
+	};
+
 	short CalculateMinLod(double left, double right, double bot, double top);
 	//short CalculateMaxLod(double left, double right, double bot, double top);
 	types::Node Intersection(types::Tile&, types::Node&, types::Node&);
@@ -0,0 +1,121 @@
+#ifndef _SERIALIZER_H_
+#define _SERIALIZER_H_
+
+#include <cstdio>
+#include <cstddef>
+#include <vector>
+
+namespace serializer
+{
+	// Zigzag mapping, small negative and positive values both get small codes
+	inline unsigned long long ZigZag(long long value)
+	{
+		return ((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63);
+	}
+
+	// Number of bytes the varint of a value takes
+	inline size_t VarintSize(unsigned long long value)
+	{
+		size_t bytes = 1;
+		while (value >= 0x80)
+		{
+			value >>= 7;
+			bytes++;
+		}
+
+		return bytes;
+	}
+
+	// Positional file access, every call carries its own offset so several threads can read or write
+	// the same file at once. The stream position is undefined afterwards (on Windows the offset moves
+	// the file pointer of the handle), so a file must not be read or written through its stdio
+	// position again without seeking first
+	bool ReadAt(FILE *in, long long offset, void *data, size_t bytes);
+	bool WriteAt(FILE *out, long long offset, const void *data, size_t bytes);
+	// Sets the size of a file up front so it can be written at any offset in any order
+	bool Preallocate(FILE *out, long long size);
+
+	// Growable byte buffer that data is encoded into before it is written with a single call,
+	// clearing it keeps the memory so one buffer can be reused for every tile.
+	// Coordinates are quantized on the grid of the current frame and stored as varint deltas
+	class Buffer
+	{
+	public:
+
+		Buffer();
+		Buffer(size_t capacity);
+
+		// Appends the raw bytes of a value
+		template<typename T>
+		void Put(const T &value)
+		{
+			Put(&value, sizeof(T));
+		}
+
+		void Put(const void *data, size_t bytes);
+		// LEB128 varint, 7 bits per byte
+		void PutVarint(unsigned long long value);
+		void PutSigned(long long value);
+
+		// Grid that following points are quantized on, the origin is the grid's zero point
+		void SetFrame(double origin_lat, double origin_lon, double step_lat, double step_lon);
+		// Starts a new point list, its first point is stored relative to the frame origin
+		void BeginPoints();
+		// Appends a coordinate pair as zigzag delta to the previous point of the list
+		void PutPoint(double lat, double lon);
+		// Appends bytes read at an offset of a file, false if the file ended early
+		bool ReadAt(FILE *in, long long offset, size_t bytes);
+		// Appends space for bytes that are filled through the returned pointer, Truncate gives back what was not used
+		char* Extend(size_t bytes);
+		void Truncate(size_t size);
+
+		void Clear();
+		size_t Size();
+		const char* Data();
+		// FNV-1a hash of the content
+		unsigned long long Hash();
+
+		// Writes the content to the file and clears the buffer, false if not everything was written
+		bool Flush(FILE *out);
+		bool FlushAt(FILE *out, long long offset);
+
+	private:
+
+		void Reserve(size_t bytes);
+
+		std::vector<char> m_data;
+		size_t m_size;
+
+		double m_origin_lat, m_origin_lon, m_step_lat, m_step_lon;
+		long long m_prev_lat, m_prev_lon;
+	};
+
+	// Reads varints from a region of a file one chunk at a time, so long tables never have to be
+	// loaded at once. Only positional reads are used
+	class Reader
+	{
+	public:
+
+		Reader();
+		Reader(FILE *in, long long begin, long long end);
+
+		// False if the region ended early or could not be read
+		bool GetVarint(unsigned long long &value);
+		// Moves on by bytes without reading them
+		void Skip(long long bytes);
+		// File offset of the next byte
+		long long Position();
+		bool End();
+
+	private:
+
+		bool Fill();
+
+		FILE *m_file;
+		long long m_at, m_end;
+		std::vector<char> m_data;
+		size_t m_pos, m_size;
+	};
+}
+
+#endif /* _SERIALIZER_H_ */
@@ -0,0 +1,114 @@
+#ifndef _SIMPLIFICATION_H_
+#define _SIMPLIFICATION_H_
+
+#include <vector>
+#include <limits>
+#include <utility>
+#include <unordered_map>
+#include "..\\header\\mathtools.h"
+
+namespace simplification
+{
+	///////////////////////////////////////////////////////
+	// Importance based algorithms
+	///////////////////////////////////////////////////////
+
+	// All vertices are ranked once, every LoD only filters by importance
+
+	class DouglasPeucker
+	{
+	public:
+		static const types::Simplification type = types::douglas_peucker;
+
+		static void Importance(vector<size_t> &line, vector<types::Node> &nodes, vector<double> &importance);
+		static void Simplify(types::Way &way, vector<types::Node> &nodes, double epsilon, size_t keep);
+	};
+
+	class VisvalingamWhyatt
+	{
+	public:
+		static const types::Simplification type = types::visvalingam_whyatt;
+
+		static void Importance(vector<size_t> &line, vector<types::Node> &nodes, vector<double> &importance);
+		static void Simplify(types::Way &way, vector<types::Node> &nodes, double epsilon, size_t keep);
+	};
+
+	///////////////////////////////////////////////////////
+	// Linear algorithms
+	///////////////////////////////////////////////////////
+
+	// Single pass over the current vertices, meant for coarse LoDs
+
+	class RadialDistance
+	{
+	public:
+		static const types::Simplification type = types::radial_distance;
+
+		static void Line(vector<size_t> &line, vector<types::Node> &nodes, double epsilon, vector<size_t> &result);
+		static void Simplify(types::Way &way, vector<types::Node> &nodes, double epsilon, size_t keep);
+	};
+
+	class ReumannWitkam
+	{
+	public:
+		static const types::Simplification type = types::reumann_witkam;
+
+		static void Line(vector<size_t> &line, vector<types::Node> &nodes, double epsilon, vector<size_t> &result);
+		static void Simplify(types::Way &way, vector<types::Node> &nodes, double epsilon, size_t keep);
+	};
+
+	class GridSnap
+	{
+	public:
+		static const types::Simplification type = types::grid_snap;
+
+		// Grid cells (row, column) the interior points are snapped to, no nodes are created here
+		static void Line(vector<size_t> &line, vector<types::Node> &nodes, double epsilon, vector<pair<long long, long long>> &cells);
+		// Snapped nodes are taken from the cell map, new ones are only added once the result is accepted
+		static void Simplify(types::Way &way, vector<types::Node> &nodes, double epsilon, unordered_map<long long, size_t> &snapped);
+	};
+
+	///////////////////////////////////////////////////////
+	// Shared Helpers
+	///////////////////////////////////////////////////////
+
+	// Computes the importance of all vertices, the closing point of circular ways is never removed
+	template<class Algorithm>
+	void RankWay(types::Way &way, vector<types::Node> &nodes)
+	{
+		bool closed = way.refs.size() > 1 && way.IsCircularWay();
+		vector<size_t> line = vector<size_t>(way.refs.begin(), closed ? way.refs.end() - 1 : way.refs.end());
+
+		Algorithm::Importance(line, nodes, way.importance);
+
+		if (closed)
+			way.importance.push_back(std::numeric_limits<double>::max());
+
+		way.ranked_size = way.refs.size();
+		way.ranking = Algorithm::type;
+	}
+
+	// Runs a linear algorithm on a way, the closing point of circular ways stays in place
+	template<class Algorithm>
+	void SimplifyLine(types::Way &way, vector<types::Node> &nodes, double epsilon)
+	{
+		bool closed = way.refs.size() > 1 && way.IsCircularWay();
+		vector<size_t> line = vector<size_t>(way.refs.begin(), closed ? way.refs.end() - 1 : way.refs.end());
+
+		vector<size_t> result = vector<size_t>();
+		result.reserve(line.size());
+		Algorithm::Line(line, nodes, epsilon, result);
+
+		// Rings need at least three distinct points, otherwise the way stays as it is
+		if (closed && result.size() < 3)
+			return;
+
+		if (closed)
+			result.push_back(result[0]);
+
+		way.refs = result;
+		way.Unrank();
+	}
+}
+
+#endif /* _SIMPLIFICATION_H_ */
@@ -0,0 +1,60 @@
+#ifndef _SPATIAL_H_
+#define _SPATIAL_H_
+
+#include <vector>
+#include <limits>
+#include "..\\header\\types.h"
+
+namespace spatial
+{
+	class Box
+	{
+	public:
+
+		Box();
+		Box(double minlat, double maxlat, double minlon, double maxlon);
+		// Bounding box of all referenced nodes
+		Box(types::Way &way, vector<types::Node> &nodes);
+		Box(vector<size_t> &refs, vector<types::Node> &nodes);
+
+		bool IsEmpty();
+		bool Intersects(Box &other, double margin);
+		double Gap(Box &other);
+		void Extend(Box &other);
+
+		double min_lat, max_lat, min_lon, max_lon;
+	};
+
+	// Uniform grid over bounding boxes, every box is registered
+	// in all cells it overlaps
+	class Grid
+	{
+	public:
+
+		Grid();
+
+		// Builds the grid over the given boxes, empty boxes are not inserted
+		void Build(vector<spatial::Box> &boxes, double cell_size);
+		void Insert(size_t index, spatial::Box &box);
+		void Clear();
+		bool Empty();
+		spatial::Box &GetBox(size_t index);
+
+		// Returns the indices of all boxes closer than margin to the box, ordered by index
+		void Query(spatial::Box &box, double margin, vector<size_t> &result);
+
+	private:
+
+		void CellRange(spatial::Box &box, double margin, size_t &row_start, size_t &row_end, size_t &col_start, size_t &col_end);
+
+		double m_minlat, m_minlon, m_cell_size;
+		size_t m_rows, m_cols;
+		vector<vector<size_t>> m_cells;
+		vector<spatial::Box> m_boxes;
+		// Last query each box was reported in, avoids duplicates
+		vector<size_t> m_stamp;
+		size_t m_query;
+	};
+}
+
+#endif /* _SPATIAL_H_ */
@@ -0,0 +1,44 @@
+#ifndef _THREADPOOL_H_
+#define _THREADPOOL_H_
+
+#include <cstddef>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+namespace threadpool
+{
+	// Fixed set of worker threads that run one indexed task at a time,
+	// the calling thread takes part in the work as well
+	class ThreadPool
+	{
+	public:
+
+		// 0 uses one thread per hardware thread
+		ThreadPool(size_t threads);
+		~ThreadPool();
+
+		// Runs task(i) for every i in [0, count) and returns when all calls are finished
+		void ForEach(size_t count, std::function<void(size_t)> task);
+		size_t Size();
+
+	private:
+
+		void Work();
+		void RunTasks(std::unique_lock<std::mutex> &lock);
+
+		std::vector<std::thread> m_workers;
+		std::mutex m_mutex;
+		std::condition_variable m_start, m_done;
+
+		std::function<void(size_t)> m_task;
+		std::exception_ptr m_error;
+		size_t m_next, m_count, m_finished, m_generation;
+		bool m_stop;
+	};
+}
+
+#endif /* _THREADPOOL_H_ */
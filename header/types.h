@@ -14,7 +14,23 @@ namespace types
 	enum Sorting {
 		most_nodes,
 		first_node,
-		subdivide
+		subdivide,
+		clip
+	};
+
+	enum Simplification {
+		douglas_peucker,
+		visvalingam_whyatt,
+		radial_distance,
+		reumann_witkam,
+		grid_snap
+	};
+
+	// Key the objects of a tile are ordered by, most important first
+	enum Importance {
+		by_type,
+		by_area,
+		by_vertices
 	};
 
 	enum Member {
@@ -58,13 +74,15 @@ namespace types
 		tree,
 		tree_row,
 		lamp,
-		street
+		street,
+		// Generated hull of a group of buildings
+		building_block
 	};
 
 	static bool IsAreaType(types::Type t)
 	{
 		return t == apartments || t == detached || t == green_land || t == farm_land || t == bare_land
-			|| t == water || t == industry || t == residential || t == graveyard || t == forest || t == plaza;
+			|| t == water || t == industry || t == residential || t == graveyard || t == forest || t == plaza || t == building_block;
 	}
 
 	static bool IsHouseType(types::Type t)
@@ -72,6 +90,12 @@ namespace types
 		return t == apartments || t == detached;
 	}
 
+	// Buildings are never merged or dropped because of their size
+	static bool IsBuildingType(types::Type t)
+	{
+		return IsHouseType(t) || t == building_block;
+	}
+
 	static bool IsRoadType(types::Type t)
 	{
 		return t == large_road || t == middle_road || t == small_road || t == path || t == street;
@@ -82,6 +106,52 @@ namespace types
 		return t == nation || t == state || t == city;
 	}
 
+	inline bool IsSingleType(types::Type t)
+	{
+		return t == tree || t == lamp;
+	}
+
+	// Drawing priority of a type, objects that give the map its structure come first
+	inline int TypePriority(types::Type t)
+	{
+		switch (t)
+		{
+			case coast: case nation: return 9;
+			case water: case state: return 8;
+			case large_road: case waterway: return 7;
+			case city: case boundary: case forest: case residential: case industry: return 6;
+			case middle_road: case farm_land: case green_land: case bare_land: return 5;
+			case street: case small_road: case graveyard: case plaza: return 4;
+			case building_block: case apartments: case detached: return 3;
+			case path: case tree_row: return 2;
+			case tree: case lamp: return 1;
+			default: return 0;
+		}
+	}
+
+	// Groups of types that are stored as separate sections of a tile, so they can be skipped as a whole
+	enum Layer {
+		layer_landcover,
+		layer_water,
+		layer_buildings,
+		layer_roads,
+		layer_boundaries,
+		layer_details
+	};
+
+	inline types::Layer TypeLayer(types::Type t)
+	{
+		switch (t)
+		{
+			case water: case waterway: case coast: return layer_water;
+			case apartments: case detached: case building_block: return layer_buildings;
+			case path: case small_road: case middle_road: case large_road: case street: return layer_roads;
+			case boundary: case city: case state: case nation: return layer_boundaries;
+			case tree: case tree_row: case lamp: return layer_details;
+			default: return layer_landcover;
+		}
+	}
+
 	class OsmObject
 	{
 	public:
@@ -95,6 +165,10 @@ namespace types
 		{
 			return types::IsAreaType(type);
 		};
+		bool IsBuilding()
+		{
+			return types::IsBuildingType(type);
+		};
 		bool IsRoad()
 		{
 			return types::IsRoadType(type);
@@ -123,6 +197,23 @@ namespace types
 		size_t pos;
 	};
 
+	// Single objects of one type that are written as one point array,
+	// the weight is the number of single objects a point stands for
+	class PointGroup
+	{
+	public:
+
+		PointGroup();
+		PointGroup(types::Type t);
+
+		void Add(double lat, double lon, unsigned int weight);
+		size_t Size();
+
+		vector<double> lats, lons;
+		vector<unsigned int> weights;
+		types::Type type;
+	};
+
 	class Tile
 	{
 	public:
@@ -130,8 +221,16 @@ namespace types
 		Tile();
 		Tile(double minlat, double maxlat, double minlon, double maxlon);
 
+		void AddPoint(types::Type t, double lat, double lon, unsigned int weight);
+
 		double min_lat, max_lat, min_lon, max_lon;
-		vector<size_t> way_refs, wayx_refs, solo_refs, relation_refs, relationx_refs;
+		vector<size_t> way_refs, wayx_refs, relation_refs, relationx_refs;
+		// Single objects, one point array per type
+		vector<types::PointGroup> point_groups;
+		// Objects that are stored once in the shared section of the LoD
+		vector<size_t> shared_way_refs, shared_relation_refs;
+		// Pieces of clipped ways, they only exist until the tile is written
+		vector<size_t> piece_refs;
 	};
 
 	class Node
@@ -197,6 +296,12 @@ namespace types
 
 		void RemoveDuplicates(vector<types::Node> *nodes);
 
+		// Vertex importance used to select the vertices of each LoD
+		bool IsRanked();
+		void Unrank();
+		void Filter(double threshold);
+		void FilterCount(size_t keep);
+
 		bool IsInsideTile(types::Tile &t, vector<types::Node> &nodes, types::Sorting sort);
 		int AtLat(types::Tile &t, vector<types::Node> &nodes, types::Sorting sort);
 		int AtLon(types::Tile &t, vector<types::Node> &nodes, types::Sorting sort);
@@ -205,6 +310,13 @@ namespace types
 		bool IsCounterClockwise(vector<types::Node> &nodes);
 
 		vector<size_t> refs;
+		// Importance of each reference, a vertex is dropped once the
+		// LoD threshold is greater than its importance
+		vector<double> importance;
+		// Number of references at the time the importance was computed
+		size_t ranked_size;
+		// Algorithm the importance was computed with
+		types::Simplification ranking;
 		long long id;
 	};
 
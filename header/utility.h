@@ -67,10 +67,13 @@ namespace utility {
 
 	void PrintInputFormat();
 	void PrintGreeting();
-	void PrintUserInput(string, string, bool, bool, logging::LogLvl, size_t[16], types::Sorting);
+	void PrintUserInput(string, string, bool, bool, logging::LogLvl, size_t[16], types::Sorting, types::Simplification[16], size_t, size_t, size_t, int[16], types::Importance);
 
-	bool CheckInput(string&, string&, string&, bool&, bool&, logging::LogLvl&, size_t(&)[16], types::Sorting&);
-	void GetUserInput(string&, string&, bool&, bool&, logging::LogLvl&, size_t(&)[16], types::Sorting&);
+	string ImportanceToString(types::Importance);
+	string SimplificationToString(types::Simplification);
+
+	bool CheckInput(string&, string&, string&, bool&, bool&, logging::LogLvl&, size_t(&)[16], types::Sorting&, types::Simplification(&)[16], size_t&, size_t&, size_t&, int(&)[16], types::Importance&);
+	void GetUserInput(string&, string&, bool&, bool&, logging::LogLvl&, size_t(&)[16], types::Sorting&, types::Simplification(&)[16], size_t&, size_t&, size_t&, int(&)[16], types::Importance&);
 }
 
 #endif /* _UTILITY_H_ */
@@ -0,0 +1,209 @@
+#include "..\\header\\clipping.h"
+
+#include <cmath>
+
+#ifdef CLIPPING_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace clipping
+{
+	// Vertex functions
+	Vertex::Vertex()
+	{
+		lat = 0.0;
+		lon = 0.0;
+		index = std::numeric_limits<size_t>::max();
+	}
+
+	Vertex::Vertex(double latitude, double longitude, size_t i)
+	{
+		lat = latitude;
+		lon = longitude;
+		index = i;
+	}
+
+	bool Vertex::IsGenerated()
+	{
+		return index == std::numeric_limits<size_t>::max();
+	}
+
+	// Classification
+	unsigned char Classify(double lat, double lon, types::Tile &tile)
+	{
+		return (lon < tile.min_lon ? out_left : 0) | (lon > tile.max_lon ? out_right : 0) |
+			(lat < tile.min_lat ? out_bottom : 0) | (lat > tile.max_lat ? out_top : 0);
+	}
+
+	void Classify(const double *lat, const double *lon, size_t count, types::Tile &tile, unsigned char *codes)
+	{
+		size_t i = 0;
+
+#ifdef CLIPPING_SSE2
+		const __m128d min_lat = _mm_set1_pd(tile.min_lat);
+		const __m128d max_lat = _mm_set1_pd(tile.max_lat);
+		const __m128d min_lon = _mm_set1_pd(tile.min_lon);
+		const __m128d max_lon = _mm_set1_pd(tile.max_lon);
+
+		// Two points per iteration, every compare yields one mask bit per point
+		for (; i + 2 <= count; i += 2)
+		{
+			__m128d la = _mm_loadu_pd(lat + i);
+			__m128d lo = _mm_loadu_pd(lon + i);
+
+			int left = _mm_movemask_pd(_mm_cmplt_pd(lo, min_lon));
+			int right = _mm_movemask_pd(_mm_cmpgt_pd(lo, max_lon));
+			int bottom = _mm_movemask_pd(_mm_cmplt_pd(la, min_lat));
+			int top = _mm_movemask_pd(_mm_cmpgt_pd(la, max_lat));
+
+			codes[i] = (unsigned char)((left & 1) * out_left | (right & 1) * out_right | (bottom & 1) * out_bottom | (top & 1) * out_top);
+			codes[i + 1] = (unsigned char)((left >> 1) * out_left | (right >> 1) * out_right | (bottom >> 1) * out_bottom | (top >> 1) * out_top);
+		}
+#endif
+
+		for (; i < count; i++)
+			codes[i] = Classify(lat[i], lon[i], tile);
+	}
+
+	// Liang-Barsky
+	bool ClipSegment(double lat0, double lon0, double lat1, double lon1, types::Tile &tile, double &t0, double &t1)
+	{
+		double dlon = lon1 - lon0;
+		double dlat = lat1 - lat0;
+
+		// Left, right, bottom and top border
+		double p[4] = { -dlon, dlon, -dlat, dlat };
+		double q[4] = { lon0 - tile.min_lon, tile.max_lon - lon0, lat0 - tile.min_lat, tile.max_lat - lat0 };
+
+		t0 = 0.0;
+		t1 = 1.0;
+
+		for (int i = 0; i < 4; i++)
+		{
+			// Parallel to this border, either completely outside or irrelevant
+			if (p[i] == 0.0)
+			{
+				if (q[i] < 0.0)
+					return false;
+
+				continue;
+			}
+
+			double r = q[i] / p[i];
+			if (p[i] < 0.0)
+				t0 = r > t0 ? r : t0;
+			else
+				t1 = r < t1 ? r : t1;
+
+			if (t0 > t1)
+				return false;
+		}
+
+		return true;
+	}
+
+	// Sutherland-Hodgman
+	static bool IsInside(clipping::Vertex &v, Outcode border, types::Tile &tile)
+	{
+		switch (border)
+		{
+			case out_left: return v.lon >= tile.min_lon;
+			case out_right: return v.lon <= tile.max_lon;
+			case out_bottom: return v.lat >= tile.min_lat;
+			case out_top: return v.lat <= tile.max_lat;
+			default: return true;
+		}
+	}
+
+	// Only called for edges crossing the border, so the divisor is never zero
+	static clipping::Vertex Crossing(clipping::Vertex &a, clipping::Vertex &b, Outcode border, types::Tile &tile)
+	{
+		double t;
+		switch (border)
+		{
+			case out_left:
+				t = (tile.min_lon - a.lon) / (b.lon - a.lon);
+				return Vertex(a.lat + t * (b.lat - a.lat), tile.min_lon, std::numeric_limits<size_t>::max());
+			case out_right:
+				t = (tile.max_lon - a.lon) / (b.lon - a.lon);
+				return Vertex(a.lat + t * (b.lat - a.lat), tile.max_lon, std::numeric_limits<size_t>::max());
+			case out_bottom:
+				t = (tile.min_lat - a.lat) / (b.lat - a.lat);
+				return Vertex(tile.min_lat, a.lon + t * (b.lon - a.lon), std::numeric_limits<size_t>::max());
+			default:
+				t = (tile.max_lat - a.lat) / (b.lat - a.lat);
+				return Vertex(tile.max_lat, a.lon + t * (b.lon - a.lon), std::numeric_limits<size_t>::max());
+		}
+	}
+
+	static void ClipBorder(std::vector<clipping::Vertex> &ring, Outcode border, types::Tile &tile, std::vector<clipping::Vertex> &result)
+	{
+		result.clear();
+
+		for (size_t i = 0; i < ring.size(); i++)
+		{
+			clipping::Vertex &current = ring[i];
+			clipping::Vertex &prev = ring[i == 0 ? ring.size() - 1 : i - 1];
+
+			bool current_in = IsInside(current, border, tile);
+			bool prev_in = IsInside(prev, border, tile);
+
+			if (current_in)
+			{
+				if (!prev_in)
+					result.push_back(Crossing(prev, current, border, tile));
+
+				result.push_back(current);
+			}
+			else if (prev_in)
+			{
+				result.push_back(Crossing(prev, current, border, tile));
+			}
+		}
+	}
+
+	void ClipRing(std::vector<clipping::Vertex> &ring, types::Tile &tile, std::vector<clipping::Vertex> &result)
+	{
+		std::vector<clipping::Vertex> tmp = std::vector<clipping::Vertex>();
+
+		result.assign(ring.begin(), ring.end());
+
+		const Outcode borders[4] = { out_left, out_right, out_bottom, out_top };
+		for (int b = 0; b < 4 && !result.empty(); b++)
+		{
+			ClipBorder(result, borders[b], tile, tmp);
+			result.swap(tmp);
+		}
+	}
+
+	double RingArea(std::vector<clipping::Vertex> &ring)
+	{
+		double sum = 0.0;
+		for (size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++)
+			sum += ring[j].lon * ring[i].lat - ring[i].lon * ring[j].lat;
+
+		return std::fabs(sum) / 2.0;
+	}
+
+	void GridCrossings(double start, double end, double origin, double step, size_t cells, std::vector<double> &result)
+	{
+		if (start == end || step <= 0.0 || cells < 2)
+			return;
+
+		double low = start < end ? start : end;
+		double high = start < end ? end : start;
+
+		// Only lines between the first and last cell split the segment
+		double first = std::ceil((low - origin) / step);
+		double last = std::floor((high - origin) / step);
+		first = first < 1.0 ? 1.0 : first;
+		last = last > (double)(cells - 1) ? (double)(cells - 1) : last;
+
+		for (double k = first; k <= last; k++)
+		{
+			double t = (origin + k * step - start) / (end - start);
+			if (t > 0.0 && t < 1.0)
+				result.push_back(t);
+		}
+	}
+}
@@ -9,6 +9,9 @@ using std::string;
 using std::unordered_map;
 using std::vector;
 using std::priority_queue;
+// Binary output
+using serializer::Buffer;
+using threadpool::ThreadPool;
 // Logging
 using logging::Logger;
 // Mathtools stuff
@@ -30,18 +33,34 @@ namespace osmconverter
 		m_debug = false;
 		m_line = true;
 		m_overflow = false;
-		m_update = false;
 
 		m_read_type[0] = true;
 		m_read_type[1] = true;
 		m_read_type[2] = true;
 
+		m_segment_tiles = 0;
+		m_segment_count = 0;
+		m_segment_stored = 0;
+		m_buffer = Buffer();
+		m_pool = std::unique_ptr<ThreadPool>(new ThreadPool(0));
+
 		m_lat_step = 0.0;
 		m_lon_step = 0.0;
 		m_minlat = m_maxlat = 0.0;
 		m_minlon = m_maxlon = 0.0;
 
 		SetSorting(Sorting::first_node);
+		SetShareThreshold(0);
+		SetRasterSize(0);
+		SetHullLoDs(0);
+		SetImportance(by_type);
+
+		// Coarse LoDs only need to drop near-duplicate vertices
+		for (short i = C_MIN_LOD; i <= C_MAX_LOD; i++)
+			m_simplify[i] = i <= 5 ? radial_distance : douglas_peucker;
+
+		for (short i = C_MIN_LOD; i <= C_MAX_LOD; i++)
+			m_compress[i] = 0;
 
 		logger = Logger();
 
@@ -66,6 +85,11 @@ namespace osmconverter
 		m_rels_left_map = unordered_map<long long, size_t>();
 
 		m_tiles = vector<Tile>();
+		m_shared_ways = unordered_map<size_t, long long>();
+		m_shared_relations = unordered_map<size_t, long long>();
+
+		m_chains = vector<Way>();
+		m_borders = unordered_map<size_t, vector<pair<size_t, bool>>>();
 	}
 
 	void Converter::CleanUp()
@@ -85,24 +109,39 @@ namespace osmconverter
 		m_rels_left_map.clear();
 
 		m_tiles.clear();
+		m_area_grid.Clear();
+		m_shared_ways.clear();
+		m_shared_relations.clear();
+		m_pieces.clear();
+		m_chains.clear();
+		m_borders.clear();
+		m_snapped.clear();
+		m_segment_tiles = 0;
+		m_segment_stored = 0;
 	}
 
 	///////////////////////////////////////////////////////
 	// Conversion Parameters and Flags
 	///////////////////////////////////////////////////////
-	void Converter::SetParameters(string in, string out, bool d, bool l, logging::LogLvl log, size_t lods[16], types::Sorting sort)
+	void Converter::SetParameters(string in, string out, bool d, bool l, logging::LogLvl log, size_t lods[16], types::Sorting sort, types::Simplification simplify[16], size_t share, size_t raster, size_t hull, int compress[16], types::Importance importance)
 	{
 		m_input = in;
 		m_debug = d;
 		m_line = l;
 
 		SetLoDs(lods);
+		SetSimplification(simplify);
 		SetSorting(sort);
+		SetShareThreshold(share);
+		SetRasterSize(raster);
+		SetHullLoDs(hull);
+		SetCompression(compress);
+		SetImportance(importance);
 		SetLoggingLevel(log);
 		SetOutputDirectory(out);
 
 		logger.Log(LogLvl::info, "Converter parametes have been set to:");
-		utility::PrintUserInput(m_input, m_output, m_debug, m_line, log, m_lods, m_sort);
+		utility::PrintUserInput(m_input, m_output, m_debug, m_line, log, m_lods, m_sort, m_simplify, m_share, m_raster, m_hull, m_compress, m_importance);
 	}
 
 	void Converter::SetOutputDirectory(string s)
@@ -144,7 +183,7 @@ namespace osmconverter
 
 	void Converter::ClearDirectory()
 	{
-		for (short i = C_MAX_LOD; i > C_MIN_LOD; i--)
+		for (short i = C_MAX_LOD; i >= C_MIN_LOD; i--)
 		{
 			string name = GetDataFilename(i);
 			size_t converted = 0, stringsize = strlen(name.data()) + 1;
@@ -193,6 +232,37 @@ namespace osmconverter
 				logger.Log(LogLvl::info, 1, string("deleted existing lookup text file for LoD " + std::to_string(i)));
 				DeleteFile(path);
 			}
+
+			name = GetSharedFilename(i);
+			stringsize = strlen(name.data()) + 1;
+			path = new wchar_t[stringsize];
+
+			mbstowcs_s(&converted, path, stringsize, name.data(), _TRUNCATE);
+			// Delete shared file if it exists, it is only ever appended to while converting
+			if (PathFileExists(path) == TRUE)
+			{
+				logger.Log(LogLvl::info, 1, string("deleted existing shared file for LoD " + std::to_string(i)));
+				DeleteFile(path);
+			}
+
+			// Delete segment files an aborted run left behind, segments are numbered without gaps
+			for (size_t s = 0;; s++)
+			{
+				name = GetSegmentFilename(i, s);
+				stringsize = strlen(name.data()) + 1;
+				path = new wchar_t[stringsize];
+
+				mbstowcs_s(&converted, path, stringsize, name.data(), _TRUNCATE);
+				if (PathFileExists(path) != TRUE)
+				{
+					delete[] path;
+					break;
+				}
+
+				logger.Log(LogLvl::info, 1, string("deleted existing segment file " + std::to_string(s) + " for LoD " + std::to_string(i)));
+				DeleteFile(path);
+				delete[] path;
+			}
 		}
 		string name = m_output + "\\meta";
 		size_t converted = 0, stringsize = strlen(name.data()) + 1;
@@ -224,6 +294,26 @@ namespace osmconverter
 		m_sort = s;
 	}
 
+	void Converter::SetShareThreshold(size_t tiles)
+	{
+		m_share = tiles;
+	}
+
+	void Converter::SetRasterSize(size_t cells)
+	{
+		m_raster = cells;
+	}
+
+	void Converter::SetHullLoDs(size_t lods)
+	{
+		m_hull = lods;
+	}
+
+	void Converter::SetImportance(types::Importance importance)
+	{
+		m_importance = importance;
+	}
+
 	void Converter::SetLoDs(size_t lods[16])
 	{
 		for (int i = C_MIN_LOD; i <= C_MAX_LOD; i++)
@@ -232,6 +322,22 @@ namespace osmconverter
 		}
 	}
 
+	void Converter::SetSimplification(types::Simplification simplify[16])
+	{
+		for (int i = C_MIN_LOD; i <= C_MAX_LOD; i++)
+		{
+			m_simplify[i] = simplify[i];
+		}
+	}
+
+	void Converter::SetCompression(int compress[16])
+	{
+		for (int i = C_MIN_LOD; i <= C_MAX_LOD; i++)
+		{
+			m_compress[i] = compress[i];
+		}
+	}
+
 	void Converter::SetLoggingLevel(logging::LogLvl lvl)
 	{
 		logger.SetMaxLoggingLevel(lvl);
@@ -352,6 +458,13 @@ namespace osmconverter
 					delete[] unpack_buffer;
 					delete[] buffer;
 
+					// Segments of all reading batches are merged in one pass per LoD
+					for (short lod = C_MAX_LOD; lod >= C_MIN_LOD; lod--)
+					{
+						if (m_lods[lod] > 0)
+							MergeSegments(lod);
+					}
+
 					WriteMetaFile(lod_count);
 					CleanUp();
 
@@ -1354,11 +1467,36 @@ namespace osmconverter
 
 	void Converter::CleanOutData()
 	{
-		bool toggle = false;
+		// Vertex importance is computed once, every LoD only filters by it
+		BuildSharedBorders();
+		RankWays();
+
 		for (short lod = C_MAX_LOD; lod >= C_MIN_LOD; lod--)
 		{
 			size_t start = 0, end = 0, tiles = 0;
 
+			// Every LoD has its own shared file
+			m_shared_ways.clear();
+			m_shared_relations.clear();
+			// Grid cells differ between LoDs
+			m_snapped.clear();
+
+			// Buildings are shown as blocks before they are shown one by one
+			if (lod >= C_BLOCK_MIN_LOD && lod <= C_BLOCK_MAX_LOD && m_lods[lod] > 0)
+				AggregateBuildings(lod);
+
+			// Landcover is re-traced from a smoothed raster at the coarsest LoDs
+			if (m_raster > 0 && lod <= C_RASTER_MAX_LOD && m_lods[lod] > 0)
+				RasterizeAreas(lod);
+
+			// Small areas are only shown as blobs at the coarsest LoDs
+			if ((size_t)lod < m_hull && m_lods[lod] > 0)
+				HullAreas(lod);
+
+			// Shared borders are simplified once for all areas using them
+			if (lod != C_MAX_LOD && m_lods[lod] > 0)
+				SimplifyBorders(lod);
+
 			while (m_lods[lod] > 0)
 			{
 				bool stop = false;
@@ -1382,31 +1520,29 @@ namespace osmconverter
 					SortLeftoverRelations(lod);
 				}*/
 
-				if (!m_update)
-				{
-					WriteDataToFile(lod);
-					toggle = true;
-				}
-				else
-				{
-					UpdateDatabase(lod);
-				}
+				WriteDataToFile(lod);
+
+				// Clipped pieces are only referenced by the tiles that were just written
+				m_pieces.clear();
 
 				if (lod == C_MAX_LOD)
 				{
 					for (;tiles < m_tiles.size(); tiles++)
 					{
-						m_way_count += m_tiles[tiles].way_refs.size() + m_tiles[tiles].wayx_refs.size();
-						m_relation_count += m_tiles[tiles].relation_refs.size() + m_tiles[tiles].relationx_refs.size();
+						m_way_count += m_tiles[tiles].way_refs.size() + m_tiles[tiles].piece_refs.size() + m_tiles[tiles].wayx_refs.size() + m_tiles[tiles].shared_way_refs.size();
+						m_relation_count += m_tiles[tiles].relation_refs.size() + m_tiles[tiles].relationx_refs.size() + m_tiles[tiles].shared_relation_refs.size();
 					}
 				}
 
 				if (stop)
 					break;
 			}
+
+			FinishSegment(lod);
 		}
-		if (toggle)
-			m_update = true;
+
+		// Every reading batch writes its own segments
+		m_segment_count++;
 	}
 
 	// Tile-Membership
@@ -1441,7 +1577,7 @@ namespace osmconverter
 			case relation:
 			{
 				double lat = 0.0, lon = 0.0;
-				if (m_sort == first_node)
+				if (m_sort == first_node || m_sort == clip)
 					m_relations[object_index].GetFirstLatLon(m_nodes, m_ways, m_relations, lat, lon);
 				else
 					GetLatLonForSearch(object_index, relation, lat, lon);
@@ -1461,6 +1597,144 @@ namespace osmconverter
 		return 0;
 	}
 
+	// Index of the tile a coordinate lies in, coordinates outside of the grid belong to the border tiles
+	size_t Converter::TileIndexAt(double lat, double lon)
+	{
+		size_t sides = std::floor(sqrt(m_tilecount));
+
+		double x_steps = std::floor((lon - m_minlon) / m_lon_step);
+		double y_steps = std::floor((lat - m_minlat) / m_lat_step);
+
+		size_t x = x_steps < 0.0 ? 0 : (x_steps >= (double)sides ? sides - 1 : (size_t)x_steps);
+		size_t y = y_steps < 0.0 ? 0 : (y_steps >= (double)sides ? sides - 1 : (size_t)y_steps);
+
+		return x + y * sides;
+	}
+
+	// Tiles a way passes through, areas cover every tile of their bounding box
+	void Converter::TouchedTiles(Way &object, vector<size_t> &tiles)
+	{
+		size_t sides = std::floor(sqrt(m_tilecount));
+		tiles.clear();
+
+		if (object.refs.empty())
+			return;
+
+		if (object.IsArea() && object.IsCircularWay())
+		{
+			spatial::Box box = spatial::Box(object, m_nodes);
+			size_t first = TileIndexAt(box.min_lat, box.min_lon), last = TileIndexAt(box.max_lat, box.max_lon);
+
+			for (size_t row = first / sides; row <= last / sides; row++)
+			{
+				for (size_t col = first % sides; col <= last % sides; col++)
+					tiles.push_back(col + row * sides);
+			}
+			return;
+		}
+
+		vector<double> cuts = vector<double>();
+		tiles.push_back(TileIndexAt(m_nodes[object.refs[0]].lat, m_nodes[object.refs[0]].lon));
+
+		for (size_t i = 1; i < object.refs.size(); i++)
+		{
+			Node &a = m_nodes[object.refs[i - 1]], &b = m_nodes[object.refs[i]];
+
+			cuts.clear();
+			clipping::GridCrossings(a.lat, b.lat, m_minlat, m_lat_step, sides, cuts);
+			clipping::GridCrossings(a.lon, b.lon, m_minlon, m_lon_step, sides, cuts);
+			cuts.push_back(1.0);
+			std::sort(cuts.begin(), cuts.end());
+
+			// Every part between two crossings lies in exactly one tile
+			double from = 0.0;
+			for (size_t c = 0; c < cuts.size(); c++)
+			{
+				double mid = (from + cuts[c]) / 2.0;
+				tiles.push_back(TileIndexAt(a.lat + mid * (b.lat - a.lat), a.lon + mid * (b.lon - a.lon)));
+				from = cuts[c];
+			}
+		}
+
+		std::sort(tiles.begin(), tiles.end());
+		tiles.erase(std::unique(tiles.begin(), tiles.end()), tiles.end());
+	}
+
+	void Converter::RelationBox(Relation &rel, spatial::Box &box, short depth)
+	{
+		for (size_t i = 0; i < rel.refs.size(); i++)
+		{
+			switch (rel.member_types[i])
+			{
+				case node:
+				{
+					spatial::Box member = spatial::Box(m_nodes[rel.refs[i]].lat, m_nodes[rel.refs[i]].lat, m_nodes[rel.refs[i]].lon, m_nodes[rel.refs[i]].lon);
+					box.Extend(member);
+				} break;
+				case way:
+				{
+					spatial::Box member = spatial::Box(m_ways[rel.refs[i]], m_nodes);
+					box.Extend(member);
+				} break;
+				case relation:
+				{
+					// Guards against relations that (indirectly) contain themselves
+					if (depth > 0)
+						RelationBox(m_relations[rel.refs[i]], box, depth - 1);
+				} break;
+			}
+		}
+	}
+
+	bool Converter::ShareWay(size_t index)
+	{
+		size_t sides = std::floor(sqrt(m_tilecount));
+
+		// A way never touches more tiles than its bounding box covers
+		spatial::Box box = spatial::Box(m_ways[index], m_nodes);
+		size_t first = TileIndexAt(box.min_lat, box.min_lon), last = TileIndexAt(box.max_lat, box.max_lon);
+		if ((last / sides - first / sides + 1) * (last % sides - first % sides + 1) < m_share)
+			return false;
+
+		vector<size_t> tiles = vector<size_t>();
+		TouchedTiles(m_ways[index], tiles);
+		if (tiles.size() < m_share)
+			return false;
+
+		for (size_t t = 0; t < tiles.size(); t++)
+		{
+			if (tiles[t] < m_tiles.size())
+				m_tiles[tiles[t]].shared_way_refs.push_back(index);
+		}
+
+		return true;
+	}
+
+	bool Converter::ShareRelation(size_t index)
+	{
+		size_t sides = std::floor(sqrt(m_tilecount));
+
+		spatial::Box box = spatial::Box();
+		RelationBox(m_relations[index], box, 8);
+		if (box.IsEmpty())
+			return false;
+
+		size_t first = TileIndexAt(box.min_lat, box.min_lon), last = TileIndexAt(box.max_lat, box.max_lon);
+		if ((last / sides - first / sides + 1) * (last % sides - first % sides + 1) < m_share)
+			return false;
+
+		for (size_t row = first / sides; row <= last / sides; row++)
+		{
+			for (size_t col = first % sides; col <= last % sides; col++)
+			{
+				if (col + row * sides < m_tiles.size())
+					m_tiles[col + row * sides].shared_relation_refs.push_back(index);
+			}
+		}
+
+		return true;
+	}
+
 	void Converter::GetLatLonForSearch(size_t object_index, types::Member mem, double &lat, double &lon)
 	{
 		struct skip {
@@ -1564,24 +1838,16 @@ namespace osmconverter
 			}
 			else if (m_sort == subdivide)
 			{
-				double x_steps = std::floor((m_nodes[m_ways[object_index].refs[0]].lon - m_minlon) / m_lon_step);
-				double y_steps = std::floor((m_nodes[m_ways[object_index].refs[0]].lat - m_minlat) / m_lat_step);
-				skip one = skip(x_steps, y_steps * sides, m_ways[object_index].refs[0]);
+				// Clip against the tile of the first point, the way then only keeps its part inside of it
+				size_t tile_index = TileIndexAt(m_nodes[m_ways[object_index].refs[0]].lat, m_nodes[m_ways[object_index].refs[0]].lon);
 
-				for (size_t i = 1; i < m_ways[object_index].refs.size(); i++)
-				{
-					if (!m_nodes[m_ways[object_index].refs[i]].IsInsideTile(m_tiles[one.lonskip + one.latskip]))
-					{
-						if (m_ways[object_index].IsArea())
-							SubdivideArea(m_tiles[one.lonskip + one.latskip], m_ways[object_index]);
-						else
-							SubdivideLine(m_tiles[one.lonskip + one.latskip], m_ways[object_index]);
+				if (tile_index < m_tiles.size())
+					Subdivide(m_tiles[tile_index], m_ways[object_index], m_ways[object_index].IsArea());
 
-						break;
-					}
-				}
-				lat = m_nodes[m_ways[object_index].refs[0]].lat;
-				lon = m_nodes[m_ways[object_index].refs[0]].lon;
+				// The center of what remains lies inside that tile
+				spatial::Box box = spatial::Box(m_ways[object_index], m_nodes);
+				lat = (box.min_lat + box.max_lat) / 2.0;
+				lon = (box.min_lon + box.max_lon) / 2.0;
 			}
 		}
 		else
@@ -1753,6 +2019,7 @@ namespace osmconverter
 				case first_node: s.assign("First Node"); break;
 				case most_nodes: s.assign("Most Nodes"); break;
 				case subdivide: s.assign("Subdivide"); break;
+				case clip: s.assign("Clip"); break;
 			}
 
 			string l = m_line ? "Douglas-Peucker" : "Visvalingam-Whyatt";
@@ -1762,6 +2029,10 @@ namespace osmconverter
 			fprintf_s(file, "Max Ways: %Iu\n", m_way_count);
 			fprintf_s(file, "Max Relations: %Iu\n", m_relation_count);
 			fprintf_s(file, "Sorting: %d (%s)\n", m_sort, s.data());
+			fprintf_s(file, "Shared Tile Threshold: %Iu\n", m_share);
+			fprintf_s(file, "Raster Cells: %Iu\n", m_raster);
+			fprintf_s(file, "Hull LoDs: %Iu\n", m_hull);
+			fprintf_s(file, "Importance: %d (%s)\n", m_importance, utility::ImportanceToString(m_importance).data());
 			fprintf_s(file, "Line Simplification Algorithm: %d (%s)\n", m_line, l.data());
 			fprintf_s(file, "LoD Count: %d\n", num_lods);
 
@@ -1769,7 +2040,7 @@ namespace osmconverter
 			for (short i = 0; i < 16; i++)
 			{
 				if (m_lods[i] != 0)
-					fprintf_s(file, "\tlod %d\n", i);
+					fprintf_s(file, "\tlod %d (%s, compression %d)\n", i, utility::SimplificationToString(m_simplify[i]).data(), m_compress[i]);
 			}
 
 			fclose(file);
@@ -1777,105 +2048,78 @@ namespace osmconverter
 	}
 
 	// Data-Output
+	// Writes the current tiles into the LoD's segment of this reading batch, segments are
+	// never rewritten and are merged into the LoD file once all data has been read
 	void Converter::WriteDataToFile(short lod)
 	{
 		FILE *out;
-		string lod_out = GetDataFilename(lod);
-		errno_t err = fopen_s(&out, lod_out.data(), "a+b");
-		if (err == 0)
-			logger.Log(LogLvl::info, "Opened data file: " + lod_out);
-		else
-			throw io_error("Data output file could not be opened");
-
-		FILE *look;
-		string look_out = GetLookupFilename(lod);
-		err = fopen_s(&look, look_out.data(), "a+b");
+		string lod_out = GetSegmentFilename(lod, m_segment_count);
+		// The first tile batch of a segment replaces leftovers of an earlier run
+		errno_t err = fopen_s(&out, lod_out.data(), m_segment_tiles == 0 ? "wb" : "ab");
 		if (err == 0)
-			logger.Log(LogLvl::info, "Opened lookup file: " + look_out);
+			logger.Log(LogLvl::info, "Opened segment file: " + lod_out);
 		else
-			throw io_error("Lookup output file could not be opened");
+			throw io_error("Segment output file could not be opened");
 
-		if (ftell(out) > 0)
-			UpdateDatabase(lod);
+		fseek(out, 0, SEEK_END);
 
-		// Used to determine lookup sizes for the lookup file
-		long int tile_prev = 0;
-
-		size_t number_tiles = m_tiles.size();
-
-		fwrite(reinterpret_cast<char*>(&number_tiles), sizeof(size_t), 1, look);
-		fwrite(reinterpret_cast<char*>(&m_lat_step), sizeof(double), 1, look);
-		fwrite(reinterpret_cast<char*>(&m_lon_step), sizeof(double), 1, look);
+		// Tiles only store the offsets of objects in the shared file
+		WriteSharedObjects(lod);
 
 		if (lod == C_MAX_LOD && m_singles.empty())
 			logger.Log(LogLvl::error, "No Singles Data");
 
-		for (size_t i = 0; i < m_tiles.size(); i++)
+		// Tiles only depend on their own objects, so they are encoded in parallel
+		// one window at a time and written in tile order by this thread
+		ThreadPool &pool = *m_pool;
+		size_t window = pool.Size() * C_ENCODE_TILES;
+		vector<Buffer> buffers = vector<Buffer>(window);
+		vector<SegmentTile> entries = vector<SegmentTile>(window);
+		Buffer head = Buffer(256);
+
+		for (size_t first = 0; first < m_tiles.size(); first += window)
 		{
-			// Write Tile header
-			size_t wsize = m_tiles[i].solo_refs.size() + m_tiles[i].way_refs.size() + m_tiles[i].wayx_refs.size();
-			size_t rsize = m_tiles[i].relation_refs.size() + m_tiles[i].relationx_refs.size();
-			fwrite(reinterpret_cast<char*>(&wsize), sizeof(size_t), 1, out);
-			fwrite(reinterpret_cast<char*>(&rsize), sizeof(size_t), 1, out);
-			fwrite(reinterpret_cast<char*>(&m_tiles[i].min_lat), sizeof(double), 1, out);
-			fwrite(reinterpret_cast<char*>(&m_tiles[i].max_lat), sizeof(double), 1, out);
-			fwrite(reinterpret_cast<char*>(&m_tiles[i].min_lon), sizeof(double), 1, out);
-			fwrite(reinterpret_cast<char*>(&m_tiles[i].max_lon), sizeof(double), 1, out);
+			size_t count = m_tiles.size() - first < window ? m_tiles.size() - first : window;
 
-			for (size_t t = 0; t < m_tiles[i].solo_refs.size(); t++)
+			pool.ForEach(count, [this, first, &buffers, &entries](size_t k)
 			{
-				// Write single object data
-				size_t single_size = 1;
-				fwrite(reinterpret_cast<char*>(&single_size), sizeof(size_t), 1, out);
-				fwrite(reinterpret_cast<char*>(&m_singles[m_tiles[i].solo_refs[t]].type), sizeof(int), 1, out);
-				fwrite(reinterpret_cast<char*>(&m_nodes[m_singles[m_tiles[i].solo_refs[t]].index].lat), sizeof(double), 1, out);
-				fwrite(reinterpret_cast<char*>(&m_nodes[m_singles[m_tiles[i].solo_refs[t]].index].lon), sizeof(double), 1, out);
-			}
+				EncodeTile(buffers[k], first + k, entries[k]);
+			});
 
-			for (size_t j = 0; j < m_tiles[i].way_refs.size(); j++)
+			for (size_t k = 0; k < count; k++)
 			{
-				// Write Way data
-				WriteWay(out, m_tiles[i].way_refs[j], true);
-			}
+				size_t index = m_segment_tiles++;
+				if (entries[k].sections.empty())
+					continue;
 
-			for (size_t j = 0; j < m_tiles[i].wayx_refs.size(); j++)
-			{
-				// Write leftover Way data
-				WriteWayX(out, m_tiles[i].wayx_refs[j], true);
-			}
+				// Every stored tile starts with the number of empty tiles before it and its sections,
+				// so the segment can be read in tile order without an offset table
+				head.PutVarint(index - m_segment_stored);
+				head.PutVarint(entries[k].sections.size());
+				for (size_t c = 0; c < entries[k].sections.size(); c++)
+				{
+					head.PutVarint(entries[k].sections[c].slot);
+					head.PutVarint(entries[k].sections[c].count);
+					head.PutVarint((unsigned long long)entries[k].sections[c].length);
+				}
 
-			// Write Relation data
-			for (size_t j = 0; j < m_tiles[i].relation_refs.size(); j++)
-			{
-				// Write Relation data
-				WriteRelation(out, m_tiles[i].relation_refs[j], true);
-			}
+				if (!head.Flush(out) || !buffers[k].Flush(out))
+					throw io_error("Segment data could not be written");
 
-			for (size_t j = 0; j < m_tiles[i].relationx_refs.size(); j++)
-			{
-				// Write Relation data
-				WriteRelationX(out, m_tiles[i].relationx_refs[j], true);
+				m_segment_stored = index + 1;
 			}
-
-			// Write Tile data into the lookup file
-			fwrite(reinterpret_cast<char*>(&m_tiles[i].min_lat), sizeof(double), 1, look);
-			fwrite(reinterpret_cast<char*>(&m_tiles[i].max_lat), sizeof(double), 1, look);
-			fwrite(reinterpret_cast<char*>(&m_tiles[i].min_lon), sizeof(double), 1, look);
-			fwrite(reinterpret_cast<char*>(&m_tiles[i].max_lon), sizeof(double), 1, look);
-			fwrite(reinterpret_cast<char*>(&tile_prev), sizeof(long int), 1, look);
-
-			tile_prev = ftell(out);
 		}
 
 		fclose(out);
-		fclose(look);
 
+		FILE *look;
+		string look_out;
 		if (m_debug)
 		{
 			lod_out = GetDataFilename(lod) + ".txt";
 			err = fopen_s(&out, lod_out.data(), "a+");
 			if (err == 0)
-				logger.Log(LogLvl::info, "Opened data text file: " + look_out);
+				logger.Log(LogLvl::info, "Opened data text file: " + lod_out);
 			else
 				throw io_error("Data output file could not be opened");
 
@@ -1890,59 +2134,77 @@ namespace osmconverter
 			fprintf_s(look, "%Iu %f %f\n", number_tiles, m_lat_step, m_lon_step);
 
 			// stores the number of lines one needs to read to get to this Tile
-			long int tile_prev = 0;
+			long long tile_prev = 0;
 
 			for (size_t i = 0; i < m_tiles.size(); i++)
 			{
 				// Write TILE HEADER
-				size_t elements = m_tiles[i].solo_refs.size() + m_tiles[i].way_refs.size();
-				fprintf_s(out, "%Iu %Iu %f %f %f %f\n", elements,
+				size_t elements = m_tiles[i].point_groups.size() + m_tiles[i].way_refs.size() + m_tiles[i].piece_refs.size();
+				fprintf_s(out, "%Iu %Iu %Iu %f %f %f %f\n", elements,
 					m_tiles[i].relation_refs.size() + m_tiles[i].relationx_refs.size(),
+					m_tiles[i].shared_way_refs.size() + m_tiles[i].shared_relation_refs.size(),
 					m_tiles[i].min_lat,
 					m_tiles[i].max_lat,
 					m_tiles[i].min_lon,
 					m_tiles[i].max_lon);
 
-				for (size_t t = 0; t < m_tiles[i].solo_refs.size(); t++)
+				for (size_t t = 0; t < m_tiles[i].point_groups.size(); t++)
 				{
 					// WRITE m_singles DATA
-					fprintf_s(out, "%d %d\n%f %f\n", 1, m_singles.at(m_tiles[i].solo_refs[t]).type,
-						m_nodes[m_singles[m_tiles[i].solo_refs[t]].index].lat, m_nodes[m_singles[m_tiles[i].solo_refs[t]].index].lon);
+					WritePointGroup(out, m_tiles[i].point_groups[t]);
 				}
 
 				for (size_t j = 0; j < m_tiles[i].way_refs.size(); j++)
 				{
 					// Write Way data
-					WriteWay(out, m_tiles[i].way_refs[j], false);
+					WriteWay(out, m_ways[m_tiles[i].way_refs[j]]);
+				}
+
+				for (size_t j = 0; j < m_tiles[i].piece_refs.size(); j++)
+				{
+					// Write clipped Way data
+					WriteWay(out, m_pieces[m_tiles[i].piece_refs[j]]);
 				}
 
 				for (size_t j = 0; j < m_tiles[i].wayx_refs.size(); j++)
 				{
 					// Write leftover Way data
-					WriteWayX(out, m_tiles[i].wayx_refs[j], false);
+					WriteWayX(out, m_tiles[i].wayx_refs[j]);
 				}
 
 				for (size_t j = 0; j < m_tiles[i].relation_refs.size(); j++)
 				{
 					// Write Relation data
-					WriteRelation(out, m_tiles[i].relation_refs[j], false);
+					WriteRelation(out, m_tiles[i].relation_refs[j]);
 				}
 
 				for (size_t j = 0; j < m_tiles[i].relationx_refs.size(); j++)
 				{
 					// Write Relation data
-					WriteRelationX(out, m_tiles[i].relationx_refs[j], false);
+					WriteRelationX(out, m_tiles[i].relationx_refs[j]);
+				}
+
+				for (size_t j = 0; j < m_tiles[i].shared_way_refs.size(); j++)
+				{
+					// Write shared Way reference
+					fprintf_s(out, "%d %lld\n", 1, m_shared_ways.at(m_tiles[i].shared_way_refs[j]));
+				}
+
+				for (size_t j = 0; j < m_tiles[i].shared_relation_refs.size(); j++)
+				{
+					// Write shared Relation reference
+					fprintf_s(out, "%d %lld\n", 0, m_shared_relations.at(m_tiles[i].shared_relation_refs[j]));
 				}
 
 				// Write Tile data into the lookup file
-				fprintf_s(look, "%f %f %f %f %d\n",
+				fprintf_s(look, "%f %f %f %f %lld\n",
 					m_tiles[i].min_lat,
 					m_tiles[i].max_lat,
 					m_tiles[i].min_lon,
 					m_tiles[i].max_lon,
 					tile_prev);
 
-				tile_prev = ftell(out);
+				tile_prev = _ftelli64(out);
 			}
 
 			fclose(look);
@@ -1950,876 +2212,1399 @@ namespace osmconverter
 		}
 	}
 
-	void Converter::UpdateDatabase(short lod)
+	// Encodes all objects of a tile tier by tier and every tier layer by layer and lists the sections that hold objects
+	void Converter::EncodeTile(Buffer &out, size_t index, SegmentTile &entry)
 	{
-		FILE *out;
-		string lod_out = m_output + "\\tmp_data";
-		errno_t err = fopen_s(&out, lod_out.data(), "wb");
-		if (err == 0)
-			logger.Log(LogLvl::info, "Opened temporary data file: " + lod_out);
-		else
-			throw io_error("Temporary data output file could not be opened");
-
-		FILE *read_out;
-		lod_out = GetDataFilename(lod);
-		err = fopen_s(&read_out, lod_out.data(), "rb");
-		if (err == 0)
-			logger.Log(LogLvl::info, "Opened data file: " + lod_out);
-		else
-			throw io_error("Data output file could not be opened");
+		Tile &tile = m_tiles[index];
 
-		FILE *look;
-		string look_out = m_output + "\\tmp_lookup";
-			err = fopen_s(&look, look_out.data(), "wb");
-		if (err == 0)
-			logger.Log(LogLvl::info, "Opened temporary lookup file: " + look_out);
-		else
-			throw io_error("Temporary lookup output file could not be opened");
+		vector<TileObject> objects = vector<TileObject>();
+		OrderTile(tile, objects);
 
-		FILE *read_look;
-		look_out = GetLookupFilename(lod);
-		err = fopen_s(&read_look, look_out.data(), "rb");
-		if (err == 0)
-			logger.Log(LogLvl::info, "Opened lookup file: " + look_out);
-		else
-			throw io_error("Lookup output file could not be opened");
+		out.Clear();
+		out.SetFrame(tile.min_lat, tile.min_lon, GetQuantum(m_lat_step), GetQuantum(m_lon_step));
 
-		size_t num_tiles = 0;
-		double latstep, lonstep;
-		// Copy lookup file header
-		fread_s(&num_tiles, sizeof(size_t), sizeof(size_t), 1, read_look);
-		fread_s(&latstep, sizeof(double), sizeof(double), 1, read_look);
-		fread_s(&lonstep, sizeof(double), sizeof(double), 1, read_look);
+		entry.start = 0;
+		entry.sections.clear();
 
-		fwrite(reinterpret_cast<char*>(&num_tiles), sizeof(size_t), 1, look);
-		fwrite(reinterpret_cast<char*>(&latstep), sizeof(double), 1, look);
-		fwrite(reinterpret_cast<char*>(&lonstep), sizeof(double), 1, look);
+		// Objects of each layer keep their importance order
+		vector<vector<size_t>> members = vector<vector<size_t>>(C_TILE_LAYERS);
+		for (size_t i = 0; i < objects.size(); i++)
+			members[objects[i].layer].push_back(i);
 
-		for (size_t i = 0; i < num_tiles; i++)
+		for (int tier = 0; tier < C_IMPORTANCE_TIERS; tier++)
 		{
-			double minlat, maxlat, minlon, maxlon;
-			size_t num_ways, num_relations;
-
-			fread_s(&num_ways, sizeof(size_t), sizeof(size_t), 1, read_out);
-			fread_s(&num_relations, sizeof(size_t), sizeof(size_t), 1, read_out);
-			fread_s(&minlat, sizeof(double), sizeof(double), 1, read_out);
-			fread_s(&maxlat, sizeof(double), sizeof(double), 1, read_out);
-			fread_s(&minlon, sizeof(double), sizeof(double), 1, read_out);
-			fread_s(&maxlon, sizeof(double), sizeof(double), 1, read_out);
-
-			size_t wsize = i < m_tiles.size() ? num_ways + m_tiles[i].way_refs.size() + m_tiles[i].solo_refs.size() : num_ways;
-			size_t rsize = i < m_tiles.size() ? num_relations + m_tiles[i].relation_refs.size() : num_relations;
-
-			fwrite(reinterpret_cast<char*>(&wsize), sizeof(size_t), 1, out);
-			fwrite(reinterpret_cast<char*>(&rsize), sizeof(size_t), 1, out);
-			fwrite(reinterpret_cast<char*>(&minlat), sizeof(double), 1, out);
-			fwrite(reinterpret_cast<char*>(&maxlat), sizeof(double), 1, out);
-			fwrite(reinterpret_cast<char*>(&minlon), sizeof(double), 1, out);
-			fwrite(reinterpret_cast<char*>(&maxlon), sizeof(double), 1, out);
-
-			// Copy existing way data to temporary file
-			for (size_t j = 0; j < wsize; j++)
+			for (int layer = 0; layer < C_TILE_LAYERS; layer++)
 			{
-				Type obj_type = none;
-				size_t obj_size;
-
-				fread_s(&obj_size, sizeof(size_t), sizeof(size_t), 1, read_out);
-				fread_s(&obj_type, sizeof(int), sizeof(int), 1, read_out);
-				fwrite(reinterpret_cast<char*>(&obj_size), sizeof(size_t), 1, out);
-				fwrite(reinterpret_cast<char*>(&obj_type), sizeof(int), 1, out);
+				// Tiers hold equal shares of the layer's objects, the last one may hold fewer
+				size_t size = members[layer].size();
+				size_t per_tier = (size + C_IMPORTANCE_TIERS - 1) / C_IMPORTANCE_TIERS;
+				size_t begin = tier * per_tier < size ? tier * per_tier : size;
+				size_t end = begin + per_tier < size ? begin + per_tier : size;
 
-				for (size_t n = 0; n < obj_size; n++)
+				for (int section = 0; section < 3; section++)
 				{
-					double lat, lon;
-					fread_s(&lat, sizeof(double), sizeof(double), 1, read_out);
-					fread_s(&lon, sizeof(double), sizeof(double), 1, read_out);
-					fwrite(reinterpret_cast<char*>(&lat), sizeof(double), 1, out);
-					fwrite(reinterpret_cast<char*>(&lon), sizeof(double), 1, out);
-				}
-			}
+					TileSection written = TileSection();
+					written.slot = (tier * C_TILE_LAYERS + layer) * 3 + section;
+					size_t start = out.Size();
 
-			if (i < m_tiles.size())
-			{
-				// Write new single object data
-				for (size_t j = 0; j < m_tiles[i].solo_refs.size(); j++)
-				{
-					size_t single_size = 1;
-					fwrite(reinterpret_cast<char*>(&single_size), sizeof(size_t), 1, out);
-					fwrite(reinterpret_cast<char*>(&m_singles[m_tiles[i].solo_refs[j]].type), sizeof(int), 1, out);
-					fwrite(reinterpret_cast<char*>(&m_nodes[m_singles[m_tiles[i].solo_refs[j]].index].lat), sizeof(double), 1, out);
-					fwrite(reinterpret_cast<char*>(&m_nodes[m_singles[m_tiles[i].solo_refs[j]].index].lon), sizeof(double), 1, out);
-				}
+					for (size_t m = begin; m < end; m++)
+					{
+						TileObject &object = objects[members[layer][m]];
+						int object_section = object.kind <= kind_wayx ? 0 : (object.kind <= kind_relationx ? 1 : 2);
+						if (object_section != section)
+							continue;
 
-				// Write new way data
-				for (size_t j = 0; j < m_tiles[i].way_refs.size(); j++)
-				{
-					WriteWay(out, m_tiles[i].way_refs[j], true);
-				}
+						EncodeObject(out, tile, object);
+						written.count++;
+					}
 
-				// Write new leftover way data
-				for (size_t j = 0; j < m_tiles[i].wayx_refs.size(); j++)
-				{
-					WriteWayX(out, m_tiles[i].wayx_refs[j], true);
+					written.length = (long long)(out.Size() - start);
+					if (written.count > 0)
+						entry.sections.push_back(written);
 				}
 			}
+		}
+	}
 
-			// Copy existing relation data to temporary file
-			for (size_t j = 0; j < rsize; j++)
+	// Collects all objects of a tile sorted by importance, the most important first
+	void Converter::OrderTile(Tile &tile, vector<TileObject> &objects)
+	{
+		auto add = [this, &tile, &objects](ObjectKind kind, size_t index)
+		{
+			TileObject object = TileObject();
+			object.kind = kind;
+			object.index = index;
+			object.layer = layer_landcover;
+
+			double area = 0.0, vertices = 0.0;
+			types::Type type = none;
+			switch (kind)
 			{
-				TransferRelation(read_out, out);
+				case kind_point_group:
+					type = tile.point_groups[index].type;
+					vertices = (double)tile.point_groups[index].Size();
+					break;
+				case kind_way:
+				case kind_shared_way:
+					type = m_ways[index].type;
+					vertices = (double)m_ways[index].Size();
+					area = m_importance == by_area ? m_ways[index].Area(m_nodes) : 0.0;
+					break;
+				case kind_piece:
+					type = m_pieces[index].type;
+					vertices = (double)m_pieces[index].Size();
+					area = m_importance == by_area ? m_pieces[index].Area(m_nodes) : 0.0;
+					break;
+				case kind_wayx:
+					type = m_ways_left[index].type;
+					vertices = (double)m_ways_left[index].nodes.size();
+					area = m_importance == by_area ? m_ways_left[index].Area() : 0.0;
+					break;
+				case kind_relation:
+				case kind_shared_relation:
+					type = m_relations[index].type;
+					vertices = (double)m_relations[index].Size();
+					area = m_importance == by_area ? m_relations[index].Area(m_nodes, m_ways, m_relations) : 0.0;
+					break;
+				case kind_relationx:
+					type = m_rels_left[index].type;
+					vertices = (double)m_rels_left[index].Size();
+					area = m_importance == by_area ? m_rels_left[index].Area() : 0.0;
+					break;
 			}
 
-			if (i < m_tiles.size())
-			{
-				// Write new relation data
-				for (size_t j = 0; j < m_tiles[i].relation_refs.size(); j++)
-				{
-					WriteRelation(out, m_tiles[i].relation_refs[j], true);
-				}
+			object.layer = TypeLayer(type);
 
-				// Write new leftover relation data
-				for (size_t j = 0; j < m_tiles[i].relationx_refs.size(); j++)
-				{
-					WriteRelationX(out, m_tiles[i].relationx_refs[j], true);
-				}
+			// Ties are broken by vertex count, ordering by vertex count itself breaks them by type priority
+			double priority = (double)TypePriority(type);
+			switch (m_importance)
+			{
+				case by_type: object.key = priority; object.tie = vertices; break;
+				case by_area: object.key = area; object.tie = vertices; break;
+				case by_vertices: object.key = vertices; object.tie = priority; break;
 			}
 
-			long int skip = 0;
-
-			fread_s(&minlat, sizeof(double), sizeof(double), 1, read_look);
-			fread_s(&maxlat, sizeof(double), sizeof(double), 1, read_look);
-			fread_s(&minlon, sizeof(double), sizeof(double), 1, read_look);
-			fread_s(&maxlon, sizeof(double), sizeof(double), 1, read_look);
-			fread_s(&skip, sizeof(long int), sizeof(long int), 1, read_look);
+			objects.push_back(object);
+		};
 
-			skip = ftell(out);
+		for (size_t i = 0; i < tile.point_groups.size(); i++)
+			add(kind_point_group, i);
+		for (size_t i = 0; i < tile.way_refs.size(); i++)
+			add(kind_way, tile.way_refs[i]);
+		for (size_t i = 0; i < tile.piece_refs.size(); i++)
+			add(kind_piece, tile.piece_refs[i]);
+		for (size_t i = 0; i < tile.wayx_refs.size(); i++)
+			add(kind_wayx, tile.wayx_refs[i]);
+		for (size_t i = 0; i < tile.relation_refs.size(); i++)
+			add(kind_relation, tile.relation_refs[i]);
+		for (size_t i = 0; i < tile.relationx_refs.size(); i++)
+			add(kind_relationx, tile.relationx_refs[i]);
+		for (size_t i = 0; i < tile.shared_way_refs.size(); i++)
+			add(kind_shared_way, tile.shared_way_refs[i]);
+		for (size_t i = 0; i < tile.shared_relation_refs.size(); i++)
+			add(kind_shared_relation, tile.shared_relation_refs[i]);
+
+		// Stable, so objects of the same importance keep their input order
+		std::stable_sort(objects.begin(), objects.end(), [](const TileObject &a, const TileObject &b)
+		{
+			return a.key > b.key || (a.key == b.key && a.tie > b.tie);
+		});
+	}
 
-			fwrite(reinterpret_cast<char*>(&minlat), sizeof(double), 1, look);
-			fwrite(reinterpret_cast<char*>(&maxlat), sizeof(double), 1, look);
-			fwrite(reinterpret_cast<char*>(&minlon), sizeof(double), 1, look);
-			fwrite(reinterpret_cast<char*>(&maxlon), sizeof(double), 1, look);
-			fwrite(reinterpret_cast<char*>(&skip), sizeof(long int), 1, look);
+	void Converter::EncodeObject(Buffer &out, Tile &tile, TileObject &object)
+	{
+		switch (object.kind)
+		{
+			case kind_point_group: EncodePointGroup(out, tile.point_groups[object.index]); break;
+			case kind_way: EncodeWay(out, m_ways[object.index]); break;
+			case kind_piece: EncodeWay(out, m_pieces[object.index]); break;
+			case kind_wayx: EncodeWayX(out, object.index); break;
+			case kind_relation: EncodeRelation(out, object.index); break;
+			case kind_relationx: EncodeRelationX(out, object.index); break;
+			case kind_shared_way:
+			{
+				out.Put(true);
+				out.PutVarint((unsigned long long)m_shared_ways.at(object.index));
+			} break;
+			case kind_shared_relation:
+			{
+				out.Put(false);
+				out.PutVarint((unsigned long long)m_shared_relations.at(object.index));
+			} break;
 		}
-
-		if (std::remove(GetDataFilename(lod).data()) == 0)
-			std::rename((m_output + "\\tmp_data").data(), GetDataFilename(lod).data());
-		else
-			throw io_error("Unable to update database data file");
-
-		if (std::remove(GetLookupFilename(lod).data()) == 0)
-			std::rename((m_output + "\\tmp_lookup").data(), GetLookupFilename(lod).data());
-		else
-			throw io_error("Unable to update database lookup file");
-
-		logger.Log(logging::LogLvl::info, string("Updated LoD %d of the database", lod));
 	}
 
-	void Converter::TransferRelation(FILE *from, FILE *to)
+	void Converter::WriteSharedObjects(short lod)
 	{
-		size_t elements = 0;
-		Type rtype = none;
+		FILE *shared;
+		string shared_out = GetSharedFilename(lod);
+		errno_t err = fopen_s(&shared, shared_out.data(), "a+b");
+		if (err == 0)
+			logger.Log(LogLvl::info, "Opened shared data file: " + shared_out);
+		else
+			throw io_error("Shared data output file could not be opened");
 
-		fread_s(&elements, sizeof(size_t), sizeof(size_t), 1, from);
-		fread_s(&rtype, sizeof(int), sizeof(int), 1, from);
+		// The file is only ever appended to, so offsets handed out earlier stay valid
+		_fseeki64(shared, 0, SEEK_END);
+		long long shared_start = _ftelli64(shared);
 
-		fwrite(reinterpret_cast<char*>(&elements), sizeof(size_t), 1, to);
-		fwrite(reinterpret_cast<char*>(&rtype), sizeof(int), 1, to);
+		// Shared objects are not bound to a tile and use the bounding box as origin
+		m_buffer.Clear();
+		m_buffer.SetFrame(m_minlat, m_minlon, GetQuantum(m_lat_step), GetQuantum(m_lon_step));
 
-		for (size_t i = 0; i < elements; i++)
+		for (size_t i = 0; i < m_tiles.size(); i++)
 		{
-			bool isway = true;
-
-			fread_s(&isway, sizeof(bool), sizeof(bool), 1, from);
-			fwrite(reinterpret_cast<char*>(&isway), sizeof(bool), 1, to);
-
-			size_t mem_size = 0;
-			MemberRole mem_role = outer;
-
-			fread_s(&mem_role, sizeof(int), sizeof(int), 1, from);
-			fread_s(&mem_size, sizeof(size_t), sizeof(size_t), 1, from);
-
-			fwrite(reinterpret_cast<char*>(&mem_role), sizeof(int), 1, to);
-			fwrite(reinterpret_cast<char*>(&mem_size), sizeof(size_t), 1, to);
-
-			if (isway)
+			for (size_t j = 0; j < m_tiles[i].shared_way_refs.size(); j++)
 			{
-				for (size_t j = 0; j < mem_size; j++)
+				size_t index = m_tiles[i].shared_way_refs[j];
+				if (m_shared_ways.find(index) == m_shared_ways.end())
 				{
-					double lat = 0.0, lon = 0.0;
-					fread_s(&lat, sizeof(double), sizeof(double), 1, from);
-					fread_s(&lon, sizeof(double), sizeof(double), 1, from);
-
-					fwrite(reinterpret_cast<char*>(&lat), sizeof(double), 1, to);
-					fwrite(reinterpret_cast<char*>(&lon), sizeof(double), 1, to);
+					m_shared_ways.insert({ index, shared_start + (long long)m_buffer.Size() });
+					EncodeWay(m_buffer, m_ways[index]);
 				}
 			}
-			else
+
+			for (size_t j = 0; j < m_tiles[i].shared_relation_refs.size(); j++)
 			{
-				TransferMemberRelation(from, to, mem_size);
+				size_t index = m_tiles[i].shared_relation_refs[j];
+				if (m_shared_relations.find(index) == m_shared_relations.end())
+				{
+					m_shared_relations.insert({ index, shared_start + (long long)m_buffer.Size() });
+					EncodeRelation(m_buffer, index);
+				}
 			}
 		}
+
+		if (!m_buffer.Flush(shared))
+			throw io_error("Shared data could not be written");
+
+		fclose(shared);
+	}
+
+	// Ends the LoD's segment with the number of tiles and the tile size so it can be read back from its end
+	void Converter::FinishSegment(short lod)
+	{
+		if (m_segment_tiles == 0)
+			return;
+
+		FILE *out;
+		string segment_out = GetSegmentFilename(lod, m_segment_count);
+		errno_t err = fopen_s(&out, segment_out.data(), "ab");
+		if (err != 0)
+			throw io_error("Segment output file could not be opened");
+
+		size_t number_tiles = m_segment_tiles;
+		fwrite(reinterpret_cast<char*>(&number_tiles), sizeof(size_t), 1, out);
+		fwrite(reinterpret_cast<char*>(&m_lat_step), sizeof(double), 1, out);
+		fwrite(reinterpret_cast<char*>(&m_lon_step), sizeof(double), 1, out);
+
+		fclose(out);
+		m_segment_tiles = 0;
+		m_segment_stored = 0;
 	}
 
-	void Converter::TransferMemberRelation(FILE * from, FILE * to, size_t size)
+	// Merges all segments of a LoD into its data file, tiles are assembled in parallel and written
+	// with positional writes, empty tiles are left out and identical tiles are stored once.
+	// Segments are read one window of tiles at a time, so memory does not grow with the tile count
+	void Converter::MergeSegments(short lod)
 	{
-		for (size_t i = 0; i < size; i++)
+		vector<FILE*> segments = vector<FILE*>();
+		vector<SegmentCursor> cursors = vector<SegmentCursor>();
+		size_t number_tiles = 0;
+		double lat_step = 0.0, lon_step = 0.0;
+		long long bound = 0;
+
+		for (size_t s = 0; s < m_segment_count; s++)
+		{
+			FILE *segment;
+			if (fopen_s(&segment, GetSegmentFilename(lod, s).data(), "rb") != 0)
+				continue;
+
+			size_t count = 0;
+			_fseeki64(segment, -(long long)(sizeof(size_t) + 2 * sizeof(double)), SEEK_END);
+			long long data_end = _ftelli64(segment);
+			if (fread_s(&count, sizeof(size_t), sizeof(size_t), 1, segment) != 1 ||
+				fread_s(&lat_step, sizeof(double), sizeof(double), 1, segment) != 1 ||
+				fread_s(&lon_step, sizeof(double), sizeof(double), 1, segment) != 1)
+				throw io_error("Segment end could not be read");
+
+			// From here on the segment is only read with positional reads
+			SegmentCursor cursor = SegmentCursor();
+			cursor.reader = serializer::Reader(segment, 0, data_end);
+			cursor.after = 0;
+			ReadSegmentTile(cursor);
+
+			number_tiles = count > number_tiles ? count : number_tiles;
+			bound += data_end;
+			segments.push_back(segment);
+			cursors.push_back(cursor);
+		}
+
+		if (segments.empty())
+			return;
+
+		FILE *out;
+		string lod_out = GetDataFilename(lod);
+		// Tiles are read back to verify duplicates
+		errno_t err = fopen_s(&out, lod_out.data(), "w+b");
+		if (err == 0)
+			logger.Log(LogLvl::info, "Opened data file: " + lod_out);
+		else
+			throw io_error("Data output file could not be opened");
+
+		FILE *look;
+		string look_out = GetLookupFilename(lod);
+		err = fopen_s(&look, look_out.data(), "wb");
+		if (err == 0)
+			logger.Log(LogLvl::info, "Opened lookup file: " + look_out);
+		else
+			throw io_error("Lookup output file could not be opened");
+
+		// zlib level of this LoD, 0 stores the tiles raw
+		int level = m_compress[lod];
+
+		// Fixed size lookup header with only 8 byte fields: grid rows and columns, tile count,
+		// bounding box, tile steps, quanta of the coordinate grid and the compression level.
+		// The offset and length of tile i follow at C_LOOKUP_HEADER + i * C_LOOKUP_STRIDE
+		// and are written one window at a time
+		Buffer lookup = Buffer(C_LOOKUP_HEADER);
+		lookup.Put((unsigned long long)m_lods[lod]);
+		lookup.Put((unsigned long long)m_lods[lod]);
+		lookup.Put((unsigned long long)number_tiles);
+		lookup.Put(m_minlat);
+		lookup.Put(m_maxlat);
+		lookup.Put(m_minlon);
+		lookup.Put(m_maxlon);
+		lookup.Put(lat_step);
+		lookup.Put(lon_step);
+		lookup.Put(GetQuantum(lat_step));
+		lookup.Put(GetQuantum(lon_step));
+		lookup.Put((long long)level);
+
+		if (!lookup.FlushAt(look, 0))
+			throw io_error("Lookup data could not be written");
+
+		ThreadPool &pool = *m_pool;
+		size_t window = pool.Size() * C_ENCODE_TILES;
+		vector<vector<SegmentTile>> tables = vector<vector<SegmentTile>>(segments.size(), vector<SegmentTile>(window));
+		vector<TileHeader> merged = vector<TileHeader>(window);
+		vector<Buffer> raw = vector<Buffer>(window);
+		vector<Buffer> packed = vector<Buffer>(level > 0 ? window : 0);
+		vector<unsigned long long> hashes = vector<unsigned long long>(window);
+
+		vector<long long> offsets = vector<long long>(window);
+		vector<long long> lengths = vector<long long>(window);
+
+		// A merged tile header is never larger than the entries of the tile in all segments, since
+		// every merged count and length is a sum of segment varints. Without duplicates the data file
+		// can not get larger than the segments, so it is sized to that and cut down at the end
+		if (level == 0 && !serializer::Preallocate(out, bound))
+			throw io_error("Data file of LoD " + std::to_string(lod) + " could not be preallocated");
+
+		// Tiles already stored by the hash of their payload
+		struct stored_tile {
+			size_t index;
+			long long offset, length;
+		};
+		unordered_map<unsigned long long, vector<stored_tile>> stored = unordered_map<unsigned long long, vector<stored_tile>>();
+		size_t empty = 0, duplicates = 0;
+		long long total = 0;
+
+		for (size_t first = 0; first < number_tiles; first += window)
 		{
-			bool isway = true;
+			size_t count = number_tiles - first < window ? number_tiles - first : window;
+			vector<Buffer> &payloads = level > 0 ? packed : raw;
+
+			// Tiles a segment did not store stay empty
+			for (size_t s = 0; s < segments.size(); s++)
+			{
+				for (size_t k = 0; k < count; k++)
+					tables[s][k].sections.clear();
 
-			fread_s(&isway, sizeof(bool), sizeof(bool), 1, from);
-			fwrite(reinterpret_cast<char*>(&isway), sizeof(bool), 1, to);
+				while (cursors[s].next < first + count)
+				{
+					SegmentTile &entry = tables[s][cursors[s].next - first];
+					entry.start = cursors[s].tile.start;
+					entry.sections.swap(cursors[s].tile.sections);
+					ReadSegmentTile(cursors[s]);
+				}
+			}
 
-			size_t mem_size = 0;
-			MemberRole mem_role = outer;
+			// Tiles are assembled, compressed and hashed in parallel
+			pool.ForEach(count, [this, level, &raw, &packed, &payloads, &hashes, &merged, &segments, &tables](size_t k)
+			{
+				MergeTileHeader(merged[k], k, tables);
+				if (merged[k].sections.empty())
+				{
+					payloads[k].Clear();
+					return;
+				}
 
-			fread_s(&mem_role, sizeof(int), sizeof(int), 1, from);
-			fread_s(&mem_size, sizeof(size_t), sizeof(size_t), 1, from);
+				AssembleTile(raw[k], k, merged[k], segments, tables);
+				if (level > 0)
+					CompressTile(raw[k], packed[k], level);
 
-			fwrite(reinterpret_cast<char*>(&mem_role), sizeof(int), 1, to);
-			fwrite(reinterpret_cast<char*>(&mem_size), sizeof(size_t), 1, to);
+				hashes[k] = payloads[k].Hash();
+			});
 
-			if (isway)
+			// Offsets are handed out in tile order, empty tiles and repeated payloads get no space of their own
+			for (size_t k = 0; k < count; k++)
 			{
-				for (size_t j = 0; j < mem_size; j++)
+				size_t i = first + k;
+				if (merged[k].sections.empty())
 				{
-					double lat = 0.0, lon = 0.0;
-					fread_s(&lat, sizeof(double), sizeof(double), 1, from);
-					fread_s(&lon, sizeof(double), sizeof(double), 1, from);
+					offsets[k] = lengths[k] = 0;
+					empty++;
+					continue;
+				}
+
+				vector<stored_tile> &candidates = stored[hashes[k]];
+				bool found = false;
+				for (size_t c = 0; c < candidates.size() && !found; c++)
+				{
+					stored_tile &tile = candidates[c];
+					if (tile.length != (long long)payloads[k].Size())
+						continue;
+
+					// Earlier tiles of this window are not written yet
+					if (tile.index >= first)
+					{
+						found = std::memcmp(payloads[tile.index - first].Data(), payloads[k].Data(), payloads[k].Size()) == 0;
+					}
+					else
+					{
+						Buffer written = Buffer(payloads[k].Size());
+						if (!written.ReadAt(out, tile.offset, payloads[k].Size()))
+							throw io_error("Data file of LoD " + std::to_string(lod) + " could not be read back");
+
+						found = std::memcmp(written.Data(), payloads[k].Data(), payloads[k].Size()) == 0;
+					}
+
+					if (found)
+					{
+						offsets[k] = tile.offset;
+						lengths[k] = tile.length;
+					}
+				}
 
-					fwrite(reinterpret_cast<char*>(&lat), sizeof(double), 1, to);
-					fwrite(reinterpret_cast<char*>(&lon), sizeof(double), 1, to);
+				if (found)
+				{
+					payloads[k].Clear();
+					duplicates++;
+					continue;
 				}
+
+				offsets[k] = total;
+				lengths[k] = (long long)payloads[k].Size();
+				total += lengths[k];
+				candidates.push_back(stored_tile{ i, offsets[k], lengths[k] });
 			}
-			else
+
+			pool.ForEach(count, [out, &payloads, &offsets](size_t k)
+			{
+				if (payloads[k].Size() > 0 && !payloads[k].FlushAt(out, offsets[k]))
+					throw io_error("Tile data could not be written");
+			});
+
+			// Empty tiles have a length of 0, duplicates point at the tile that was stored first
+			for (size_t k = 0; k < count; k++)
 			{
-				TransferMemberRelation(from, to, mem_size);
+				lookup.Put((unsigned long long)offsets[k]);
+				lookup.Put((unsigned long long)lengths[k]);
 			}
+
+			if (!lookup.FlushAt(look, (long long)(C_LOOKUP_HEADER + first * C_LOOKUP_STRIDE)))
+				throw io_error("Lookup data could not be written");
 		}
+
+		if (level == 0 && !serializer::Preallocate(out, total))
+			throw io_error("Data file of LoD " + std::to_string(lod) + " could not be truncated");
+
+		logger.Log(LogLvl::info, "LoD " + std::to_string(lod) + ": " + std::to_string(empty) + " empty and " +
+			std::to_string(duplicates) + " duplicate tiles were not stored");
+
+		fclose(out);
+		fclose(look);
+
+		for (size_t s = 0; s < segments.size(); s++)
+			fclose(segments[s]);
+
+		for (size_t s = 0; s < m_segment_count; s++)
+			std::remove(GetSegmentFilename(lod, s).data());
+
+		logger.Log(LogLvl::info, "Merged " + std::to_string(segments.size()) + " segments of LoD " + std::to_string(lod));
 	}
 
-	void Converter::WriteNode(FILE *out, size_t index, bool b)
+	// Reads the entry of the next stored tile of a segment and skips its payload, the index of
+	// the tile is the number of tiles once the segment ended
+	void Converter::ReadSegmentTile(SegmentCursor &cursor)
 	{
-		if (b)
+		if (cursor.reader.End())
 		{
-			fwrite(reinterpret_cast<char*>(&m_nodes.at(index).lat), sizeof(double), 1, out);
-			fwrite(reinterpret_cast<char*>(&m_nodes.at(index).lon), sizeof(double), 1, out);
+			cursor.next = std::numeric_limits<size_t>::max();
+			cursor.tile.sections.clear();
+			return;
 		}
-		else
+
+		unsigned long long gap = 0, sections = 0;
+		if (!cursor.reader.GetVarint(gap) || !cursor.reader.GetVarint(sections) || sections > C_TILE_SECTIONS)
+			throw io_error("Segment tile could not be read");
+
+		cursor.next = cursor.after + (size_t)gap;
+		cursor.after = cursor.next + 1;
+		cursor.tile.sections.resize((size_t)sections);
+
+		long long length = 0;
+		for (size_t c = 0; c < cursor.tile.sections.size(); c++)
 		{
-			fprintf_s(out, "%.7f %.7f\n", m_nodes.at(index).lat, m_nodes.at(index).lon);
+			unsigned long long slot = 0, count = 0, bytes = 0;
+			if (!cursor.reader.GetVarint(slot) || !cursor.reader.GetVarint(count) || !cursor.reader.GetVarint(bytes) || slot >= C_TILE_SECTIONS)
+				throw io_error("Segment tile could not be read");
+
+			cursor.tile.sections[c].slot = (size_t)slot;
+			cursor.tile.sections[c].count = (size_t)count;
+			cursor.tile.sections[c].length = (long long)bytes;
+			length += (long long)bytes;
 		}
+
+		cursor.tile.start = cursor.reader.Position();
+		cursor.reader.Skip(length);
 	}
 
-	void Converter::WriteWay(FILE *out, size_t index, bool b)
+	// Sums the sections of one tile of the window over all segments
+	void Converter::MergeTileHeader(TileHeader &merged, size_t k, vector<vector<SegmentTile>> &tables)
 	{
-		size_t node_count = m_ways[index].Size();
+		size_t counts[C_TILE_SECTIONS] = { 0 };
+		long long lengths[C_TILE_SECTIONS] = { 0 };
 
-		if (b)
+		for (size_t s = 0; s < tables.size(); s++)
 		{
-			fwrite(reinterpret_cast<char*>(&node_count), sizeof(size_t), 1, out);
-			fwrite(reinterpret_cast<char*>(&m_ways[index].type), sizeof(int), 1, out);
-		}
-		else
-		{
-			fprintf_s(out, "%Iu %d\n", node_count, m_ways[index].type);
+			vector<TileSection> &sections = tables[s][k].sections;
+			for (size_t c = 0; c < sections.size(); c++)
+			{
+				counts[sections[c].slot] += sections[c].count;
+				lengths[sections[c].slot] += sections[c].length;
+			}
 		}
 
-		for (size_t n = 0; n < node_count; n++)
+		merged.sections.clear();
+		for (size_t slot = 0; slot < C_TILE_SECTIONS; slot++)
 		{
-			WriteNode(out, m_ways[index].refs[n], b);
+			if (counts[slot] == 0)
+				continue;
+
+			TileSection section = TileSection();
+			section.slot = slot;
+			section.count = counts[slot];
+			section.length = lengths[slot];
+			merged.sections.push_back(section);
 		}
 	}
 
-	void Converter::WriteWayX(FILE *out, size_t index, bool b)
+	// Collects the header and the sections of a tile from all segments. The header is a directory
+	// with the number of non-empty sections followed by the slot, object count and byte length of
+	// each of them in storage order, so readers can sum the lengths to seek straight to the layers
+	// they show. Every section holds the objects of all segments in segment order. The segments are
+	// only read with positional reads so several tiles can be assembled at once
+	void Converter::AssembleTile(Buffer &out, size_t k, TileHeader &merged, vector<FILE*> &segments, vector<vector<SegmentTile>> &tables)
 	{
-		size_t node_count = m_ways_left[index].nodes.size();
-		if (b)
-		{
-			fwrite(reinterpret_cast<char*>(&node_count), sizeof(size_t), 1, out);
-			fwrite(reinterpret_cast<char*>(&m_ways_left[index].type), sizeof(int), 1, out);
-		}
-		else
+		out.Clear();
+		out.PutVarint(merged.sections.size());
+		for (size_t c = 0; c < merged.sections.size(); c++)
 		{
-			fprintf_s(out, "%Iu %d\n", node_count, m_ways_left[index].type);
+			out.PutVarint(merged.sections[c].slot);
+			out.PutVarint(merged.sections[c].count);
+			out.PutVarint((unsigned long long)merged.sections[c].length);
 		}
 
-		for (size_t i = 0; i < m_ways_left[index].nodes.size(); i++)
+		// Position in the section list and the payload of every segment's part of the tile
+		vector<size_t> next = vector<size_t>(segments.size(), 0);
+		vector<long long> at = vector<long long>(segments.size());
+		for (size_t s = 0; s < segments.size(); s++)
+			at[s] = tables[s][k].start;
+
+		for (size_t c = 0; c < merged.sections.size(); c++)
 		{
-			if (b)
-			{
-				fwrite(reinterpret_cast<char*>(&m_ways_left[index].nodes[i].lat), sizeof(double), 1, out);
-				fwrite(reinterpret_cast<char*>(&m_ways_left[index].nodes[i].lon), sizeof(double), 1, out);
-			}
-			else
+			for (size_t s = 0; s < segments.size(); s++)
 			{
-				fprintf_s(out, "%f %f\n", m_ways_left[index].nodes[i].lat, m_ways_left[index].nodes[i].lon);
+				vector<TileSection> &sections = tables[s][k].sections;
+				if (next[s] >= sections.size() || sections[next[s]].slot != merged.sections[c].slot)
+					continue;
+
+				long long bytes = sections[next[s]].length;
+				if (bytes > 0 && !out.ReadAt(segments[s], at[s], (size_t)bytes))
+					throw io_error("Segment file could not be read");
 
+				at[s] += bytes;
+				next[s]++;
 			}
 		}
 	}
 
-	void Converter::WriteRelation(FILE *out, size_t index, bool b)
+	// Compressed tiles start with their raw size as 8 byte integer so readers can allocate the
+	// output, like all other fixed fields it has the same width on every platform
+	void Converter::CompressTile(Buffer &raw, Buffer &packed, int level)
 	{
-		size_t elements = m_relations[index].Size();
+		size_t raw_size = raw.Size();
+		uLongf packed_size = compressBound((uLong)raw_size);
+
+		packed.Clear();
+		packed.Put((unsigned long long)raw_size);
+		char *data = packed.Extend(packed_size);
+
+		if (compress2((Bytef*)data, &packed_size, (const Bytef*)raw.Data(), (uLong)raw_size, level) != Z_OK)
+			throw io_error("Tile could not be compressed");
+
+		packed.Truncate(sizeof(unsigned long long) + packed_size);
+		raw.Clear();
+	}
+
+	///////////////////////////////////////////////////////
+	// Binary Encoding
+	///////////////////////////////////////////////////////
+	// Coordinate precision of a LoD, a fixed fraction of the tile side but never finer than OSM itself
+	double Converter::GetQuantum(double step)
+	{
+		double quantum = step / C_QUANT_STEPS;
+		return quantum > C_QUANT_MIN ? quantum : C_QUANT_MIN;
+	}
+
+	void Converter::EncodeNode(Buffer &out, size_t index)
+	{
+		out.PutPoint(m_nodes.at(index).lat, m_nodes.at(index).lon);
+	}
+
+	void Converter::EncodeWay(Buffer &out, Way &object)
+	{
+		size_t node_count = object.Size();
+
+		out.PutVarint(node_count);
+		out.PutVarint((unsigned int)object.type);
 
-		if (b)
+		out.BeginPoints();
+		for (size_t n = 0; n < node_count; n++)
 		{
-			fwrite(reinterpret_cast<char*>(&elements), sizeof(size_t), 1, out);
-			fwrite(reinterpret_cast<char*>(&m_relations[index].type), sizeof(int), 1, out);
+			EncodeNode(out, object.refs[n]);
 		}
-		else
+	}
+
+	// Point array of all single objects of one type in a tile, the coordinates are followed by the weights
+	void Converter::EncodePointGroup(Buffer &out, PointGroup &group)
+	{
+		size_t point_count = group.Size();
+
+		out.PutVarint(point_count);
+		out.PutVarint((unsigned int)group.type);
+
+		out.BeginPoints();
+		for (size_t n = 0; n < point_count; n++)
 		{
-			fprintf_s(out, "%Iu %d\n", elements, m_relations[index].type);
+			out.PutPoint(group.lats[n], group.lons[n]);
 		}
 
-		for (size_t n = 0; n < elements; n++)
+		for (size_t n = 0; n < point_count; n++)
+		{
+			out.PutVarint(group.weights[n]);
+		}
+	}
+
+	void Converter::EncodeWayX(Buffer &out, size_t index)
+	{
+		size_t node_count = m_ways_left[index].nodes.size();
+
+		out.PutVarint(node_count);
+		out.PutVarint((unsigned int)m_ways_left[index].type);
+
+		out.BeginPoints();
+		for (size_t i = 0; i < node_count; i++)
+		{
+			out.PutPoint(m_ways_left[index].nodes[i].lat, m_ways_left[index].nodes[i].lon);
+		}
+	}
+
+	void Converter::EncodeRelation(Buffer &out, size_t index)
+	{
+		size_t elements = m_relations[index].Size();
+
+		out.PutVarint(elements);
+		out.PutVarint((unsigned int)m_relations[index].type);
+
+		EncodeMembers(out, index);
+	}
+
+	// Members of a complete relation, shared by top level relations and relation members
+	void Converter::EncodeMembers(Buffer &out, size_t index)
+	{
+		for (size_t n = 0; n < m_relations[index].Size(); n++)
 		{
 			bool is_way_node = m_relations[index].member_types[n] != relation ? true : false;
+
+			out.Put(is_way_node);
+			out.PutVarint((unsigned int)m_relations[index].roles[n]);
+
 			switch (m_relations[index].member_types[n])
 			{
 				case node:
 				{
-					if (b)
-					{
-						size_t one = 1;
-						fwrite(reinterpret_cast<char*>(&is_way_node), sizeof(bool), 1, out);
-						fwrite(reinterpret_cast<char*>(&m_relations[index].roles[n]), sizeof(int), 1, out);
-						fwrite(reinterpret_cast<char*>(&one), sizeof(size_t), 1, out);
-					}
-					else
-					{
-						fprintf_s(out, "%d %d %d\n", m_relations[index].member_types[n], m_relations[index].roles[n], 1);
-					}
-					WriteNode(out, m_relations[index].refs[n], b);
+					out.PutVarint(1);
+					out.BeginPoints();
+					EncodeNode(out, m_relations[index].refs[n]);
 				} break;
 				case way:
 				{
-					if (b)
-					{
-						fwrite(reinterpret_cast<char*>(&is_way_node), sizeof(bool), 1, out);
-						fwrite(reinterpret_cast<char*>(&m_relations[index].roles[n]), sizeof(int), 1, out);
-					}
-					else
-					{
-						fprintf_s(out, "%d %d ", m_relations[index].member_types[n], m_relations[index].roles[n]);
-					}
-					WriteMemberWay(out, m_relations[index].refs[n], b);
+					EncodeMemberWay(out, m_relations[index].refs[n]);
 				} break;
 				case relation:
 				{
-					if (b)
-					{
-						fwrite(reinterpret_cast<char*>(&is_way_node), sizeof(bool), 1, out);
-						fwrite(reinterpret_cast<char*>(&m_relations[index].roles[n]), sizeof(int), 1, out);
-					}
-					else
-					{
-						fprintf_s(out, "%d %d ", m_relations[index].member_types[n], m_relations[index].roles[n]);
-					}
-					WriteMemberRelation(out, m_relations[index].refs[n], b);
+					EncodeMemberRelation(out, m_relations[index].refs[n]);
 				} break;
 			}
 		}
 	}
 
-	void Converter::WriteRelationX(FILE *out, size_t index, bool b)
+	void Converter::EncodeRelationX(Buffer &out, size_t index)
 	{
 		size_t elements = m_rels_left[index].Size();
 
-		if (b)
-		{
-			fwrite(reinterpret_cast<char*>(&elements), sizeof(size_t), 1, out);
-			fwrite(reinterpret_cast<char*>(&m_rels_left[index].type), sizeof(int), 1, out);
-		}
-		else
-		{
-			fprintf_s(out, "%Iu %d\n", elements, m_rels_left[index].type);
-		}
+		out.PutVarint(elements);
+		out.PutVarint((unsigned int)m_rels_left[index].type);
 
 		for (size_t i = 0; i < m_rels_left[index].roles.size(); i++)
 		{
 			bool is_way_node = m_rels_left[index].roles[i].as != relation ? true : false;
+
+			out.Put(is_way_node);
+			out.PutVarint((unsigned int)m_rels_left[index].roles[i].as);
+
 			switch (m_rels_left[index].roles[i].vec)
 			{
 				case node:
 				{
-					if (b)
-					{
-						size_t one = 1;
-						fwrite(reinterpret_cast<char*>(&is_way_node), sizeof(bool), 1, out);
-						fwrite(reinterpret_cast<char*>(&m_rels_left[index].roles[i].as), sizeof(int), 1, out);
-						fwrite(reinterpret_cast<char*>(&one), sizeof(size_t), 1, out);
-						fwrite(reinterpret_cast<char*>(&m_rels_left[index].nodes[i].lat), sizeof(double), 1, out);
-						fwrite(reinterpret_cast<char*>(&m_rels_left[index].nodes[i].lon), sizeof(double), 1, out);
-					}
-					else
-					{
-						fprintf_s(out, "%d %d %Iu %f %f\n", is_way_node, m_rels_left[index].roles[i].as, 1,
-										m_rels_left[index].nodes[i].lat, m_rels_left[index].nodes[i].lon);
-					}
+					out.PutVarint(1);
+					out.BeginPoints();
+					out.PutPoint(m_rels_left[index].nodes[i].lat, m_rels_left[index].nodes[i].lon);
 				} break;
 				case way:
 				{
-					if (b)
-					{
-						fwrite(reinterpret_cast<char*>(&is_way_node), sizeof(bool), 1, out);
-						fwrite(reinterpret_cast<char*>(&m_rels_left[index].roles[i].as), sizeof(int), 1, out);
-					}
-					else
-					{
-						fprintf_s(out, "%d %d ", is_way_node, m_rels_left[index].roles[i].as);
-					}
-					WriteXMemberWay(out, index, i, b);
+					EncodeXMemberWay(out, index, i);
 				} break;
 				case relation:
 				{
-					if (b)
-					{
-						fwrite(reinterpret_cast<char*>(&is_way_node), sizeof(bool), 1, out);
-						fwrite(reinterpret_cast<char*>(&m_rels_left[index].roles[i].as), sizeof(int), 1, out);
-					}
-					else
-					{
-						fprintf_s(out, "%d %d ", is_way_node, m_rels_left[index].roles[i].as);
-					}
-					WriteXMemberRelation(out, index, i, b);
+					EncodeXMemberRelation(out, index, i);
 				} break;
 			}
 		}
 	}
 
-	void Converter::WriteXMemberWay(FILE *out, size_t index, size_t obj, bool b)
+	void Converter::EncodeXMemberWay(Buffer &out, size_t index, size_t obj)
 	{
 		size_t elements = m_rels_left[index].ways[obj].Size();
 
-		if (b)
-			fwrite(reinterpret_cast<char*>(&elements), sizeof(size_t), 1, out);
-		else
-			fprintf_s(out, "%Iu\n", elements);
+		out.PutVarint(elements);
 
+		out.BeginPoints();
 		for (size_t i = 0; i < elements; i++)
 		{
-			if (b)
-			{
-				fwrite(reinterpret_cast<char*>(&m_rels_left[index].ways[obj].nodes[i].lat), sizeof(double), 1, out);
-				fwrite(reinterpret_cast<char*>(&m_rels_left[index].ways[obj].nodes[i].lon), sizeof(double), 1, out);
-			}
-			else
-			{
-				fprintf_s(out, "%f %f\n", m_rels_left[index].ways[obj].nodes[i].lat, m_rels_left[index].ways[obj].nodes[i].lon);
-			}
+			out.PutPoint(m_rels_left[index].ways[obj].nodes[i].lat, m_rels_left[index].ways[obj].nodes[i].lon);
 		}
 	}
 
-	void Converter::WriteXMemberRelation(FILE *out, size_t index, size_t obj, bool b)
+	void Converter::EncodeXMemberRelation(Buffer &out, size_t index, size_t obj)
 	{
 		size_t elements = m_rels_left[index].relations[obj].Size();
 
-		if (b)
-			fwrite(reinterpret_cast<char*>(&elements), sizeof(size_t), 1, out);
-		else
-			fprintf_s(out, "%Iu\n", elements);
+		out.PutVarint(elements);
 
 		for (size_t i = 0; i < elements; i++)
 		{
 			bool is_way_node = m_rels_left[index].relations[obj].roles[i].vec == relation ? false : true;
+
+			out.Put(is_way_node);
+			out.PutVarint((unsigned int)m_rels_left[index].relations[obj].roles[i].as);
+
 			switch (m_rels_left[index].relations[obj].roles[i].vec)
 			{
 				case node:
 				{
-					if (b)
-					{
-						size_t one = 1;
-						fwrite(reinterpret_cast<char*>(&is_way_node), sizeof(bool), 1, out);
-						fwrite(reinterpret_cast<char*>(&m_rels_left[index].relations[obj].roles[i].as), sizeof(int), 1, out);
-						fwrite(reinterpret_cast<char*>(&one), sizeof(size_t), 1, out);
-						fwrite(reinterpret_cast<char*>(&m_rels_left[index].relations[obj].nodes[i].lat), sizeof(double), 1, out);
-						fwrite(reinterpret_cast<char*>(&m_rels_left[index].relations[obj].nodes[i].lon), sizeof(double), 1, out);
-					}
-					else
-					{
-						fprintf_s(out, "%d %d %Iu %f %f\n", is_way_node, m_rels_left[index].relations[obj].roles[i].as, 1,
-							m_rels_left[index].relations[obj].nodes[i].lat, m_rels_left[index].relations[obj].nodes[i].lon);
-					}
+					out.PutVarint(1);
+					out.BeginPoints();
+					out.PutPoint(m_rels_left[index].relations[obj].nodes[i].lat, m_rels_left[index].relations[obj].nodes[i].lon);
 				} break;
 				case way:
 				{
-					if (b)
-					{
-						fwrite(reinterpret_cast<char*>(&is_way_node), sizeof(bool), 1, out);
-						fwrite(reinterpret_cast<char*>(&m_rels_left[index].relations[obj].roles[i].as), sizeof(int), 1, out);
-					}
-					else
-					{
-						fprintf_s(out, "%d %d ", is_way_node, m_rels_left[index].relations[obj].roles[i].as);
-					}
-					WriteXMemberWay(out, obj, i, b);
+					EncodeXMemberWay(out, obj, i);
 				} break;
 				case relation:
 				{
-					if (b)
-					{
-						fwrite(reinterpret_cast<char*>(&is_way_node), sizeof(bool), 1, out);
-						fwrite(reinterpret_cast<char*>(&m_rels_left[index].relations[obj].roles[i].as), sizeof(int), 1, out);
-					}
-					else
-					{
-						fprintf_s(out, "%d %d ", is_way_node, m_rels_left[index].relations[obj].roles[i].as);
-					}
-					WriteXMemberRelation(out, obj, i, b);
+					EncodeXMemberRelation(out, obj, i);
 				} break;
 			}
 		}
 	}
 
-	void Converter::WriteMemberWay(FILE *out, size_t index, bool b)
+	void Converter::EncodeMemberWay(Buffer &out, size_t index)
 	{
 		size_t node_count = m_ways[index].Size();
 
-		if (b)
-			fwrite(reinterpret_cast<char*>(&node_count), sizeof(size_t), 1, out);
-		else
-			fprintf_s(out, "%Iu\n", node_count);
+		out.PutVarint(node_count);
 
+		out.BeginPoints();
 		for (size_t n = 0; n < node_count; n++)
 		{
-			WriteNode(out, m_ways[index].refs[n], b);
+			EncodeNode(out, m_ways[index].refs[n]);
 		}
 	}
 
-	void Converter::WriteMemberRelation(FILE *out, size_t index, bool b)
+	void Converter::EncodeMemberRelation(Buffer &out, size_t index)
 	{
 		size_t elements = m_relations.at(index).Size();
 
-		if (b)
-			fwrite(reinterpret_cast<char*>(&elements), sizeof(size_t), 1, out);
-		else
-			fprintf_s(out, "%Iu\n", elements);
+		out.PutVarint(elements);
 
-		for (size_t n = 0; n < m_relations[index].Size(); n++)
-		{
-			bool is_way_node = m_relations[index].member_types[n] != relation ? true : false;
-			switch (m_relations[index].member_types[n])
-			{
-			case node:
-			{
-				if (b)
-				{
-					size_t one = 1;
-					fwrite(reinterpret_cast<char*>(&is_way_node), sizeof(bool), 1, out);
-					fwrite(reinterpret_cast<char*>(&m_relations[m_relations[index].roles[n]]), sizeof(int), 1, out);
-					fwrite(reinterpret_cast<char*>(&one), sizeof(size_t), 1, out);
-				}
-				else
-				{
-					fprintf_s(out, "%d %d %d\n", m_relations[index].member_types[n], m_relations[index].roles[n], 1);
-				}
-				WriteNode(out, m_relations[index].refs[n], b);
-			} break;
-			case way:
-			{
-				if (b)
-				{
-					fwrite(reinterpret_cast<char*>(&is_way_node), sizeof(bool), 1, out);
-					fwrite(reinterpret_cast<char*>(&m_relations[m_relations[index].roles[n]]), sizeof(int), 1, out);
-				}
-				else
-				{
-					fprintf_s(out, "%d %d", m_relations[index].member_types[n], m_relations[index].roles[n]);
-				}
-				WriteMemberWay(out, m_relations[index].refs[n], b);
-			} break;
-			case relation:
-			{
-				if (b)
-				{
-					fwrite(reinterpret_cast<char*>(&is_way_node), sizeof(bool), 1, out);
-					fwrite(reinterpret_cast<char*>(&m_relations[m_relations[index].roles[n]]), sizeof(int), 1, out);
-				}
-				else
-				{
-					fprintf_s(out, "%d %d", m_relations[index].member_types[n], m_relations[index].roles[n]);
-				}
-				WriteMemberRelation(out, m_relations[index].refs[n], b);
-			} break;
-			}
-		}
+		EncodeMembers(out, index);
 	}
 
-	// Filenames
-	string Converter::GetDataFilename(short lod)
+	///////////////////////////////////////////////////////
+	// Text Output
+	///////////////////////////////////////////////////////
+	void Converter::WriteNode(FILE *out, size_t index)
 	{
-		string s = m_output;
-		if (lod < 10)
-			s += string("\\lod0") + std::to_string(lod);
-		else
-			s += string("\\lod") + std::to_string(lod);
-
-		return s;
+		fprintf_s(out, "%.7f %.7f\n", m_nodes.at(index).lat, m_nodes.at(index).lon);
 	}
 
-	string Converter::GetLookupFilename(short lod)
+	void Converter::WriteWay(FILE *out, Way &object)
 	{
-		string s = m_output;
-		if (lod < 10)
-			s += string("\\lookup0") + std::to_string(lod);
-		else
-			s += string("\\lookup") + std::to_string(lod);
+		size_t node_count = object.Size();
 
-		return s;
+		fprintf_s(out, "%Iu %d\n", node_count, object.type);
+
+		for (size_t n = 0; n < node_count; n++)
+		{
+			WriteNode(out, object.refs[n]);
+		}
 	}
 
-	///////////////////////////////////////////////////////
-	// Data Generalization
-	///////////////////////////////////////////////////////
-	size_t Converter::SubdivideLine(types::Tile &lod_tile, Way &object)
+	void Converter::WritePointGroup(FILE *out, PointGroup &group)
 	{
-		return Subdivide(lod_tile, object, false);
+		size_t point_count = group.Size();
+
+		fprintf_s(out, "%Iu %d\n", point_count, group.type);
+
+		for (size_t n = 0; n < point_count; n++)
+		{
+			fprintf_s(out, "%f %f %u\n", group.lats[n], group.lons[n], group.weights[n]);
+		}
 	}
 
-	size_t Converter::SubdivideArea(types::Tile &lod_tile, Way &object)
+	void Converter::WriteWayX(FILE *out, size_t index)
 	{
-		return Subdivide(lod_tile, object, true);
+		size_t node_count = m_ways_left[index].nodes.size();
+
+		fprintf_s(out, "%Iu %d\n", node_count, m_ways_left[index].type);
+
+		for (size_t i = 0; i < node_count; i++)
+		{
+			fprintf_s(out, "%f %f\n", m_ways_left[index].nodes[i].lat, m_ways_left[index].nodes[i].lon);
+		}
 	}
 
-	size_t Converter::Subdivide(types::Tile &lod_tile, Way &object, bool save_last)
+	void Converter::WriteRelation(FILE *out, size_t index)
 	{
-		// Defines a line segment
-		struct line {
-			// First and last point that are inside or outside - depending on inside's value
-			size_t first, last;
-			bool inside;
+		size_t elements = m_relations[index].Size();
 
-			line()
+		fprintf_s(out, "%Iu %d\n", elements, m_relations[index].type);
+
+		for (size_t n = 0; n < elements; n++)
+		{
+			switch (m_relations[index].member_types[n])
 			{
-				line(0, 0, false);
+				case node:
+				{
+					fprintf_s(out, "%d %d %d\n", m_relations[index].member_types[n], m_relations[index].roles[n], 1);
+					WriteNode(out, m_relations[index].refs[n]);
+				} break;
+				case way:
+				{
+					fprintf_s(out, "%d %d ", m_relations[index].member_types[n], m_relations[index].roles[n]);
+					WriteMemberWay(out, m_relations[index].refs[n]);
+				} break;
+				case relation:
+				{
+					fprintf_s(out, "%d %d ", m_relations[index].member_types[n], m_relations[index].roles[n]);
+					WriteMemberRelation(out, m_relations[index].refs[n]);
+				} break;
 			}
-			line(size_t i, size_t j, bool b)
+		}
+	}
+
+	void Converter::WriteRelationX(FILE *out, size_t index)
+	{
+		size_t elements = m_rels_left[index].Size();
+
+		fprintf_s(out, "%Iu %d\n", elements, m_rels_left[index].type);
+
+		for (size_t i = 0; i < m_rels_left[index].roles.size(); i++)
+		{
+			bool is_way_node = m_rels_left[index].roles[i].as != relation ? true : false;
+			switch (m_rels_left[index].roles[i].vec)
 			{
-				first = i;
-				last = j;
-				inside = b;
+				case node:
+				{
+					fprintf_s(out, "%d %d %Iu %f %f\n", is_way_node, m_rels_left[index].roles[i].as, 1,
+									m_rels_left[index].nodes[i].lat, m_rels_left[index].nodes[i].lon);
+				} break;
+				case way:
+				{
+					fprintf_s(out, "%d %d ", is_way_node, m_rels_left[index].roles[i].as);
+					WriteXMemberWay(out, index, i);
+				} break;
+				case relation:
+				{
+					fprintf_s(out, "%d %d ", is_way_node, m_rels_left[index].roles[i].as);
+					WriteXMemberRelation(out, index, i);
+				} break;
 			}
-		};
+		}
+	}
+
+	void Converter::WriteXMemberWay(FILE *out, size_t index, size_t obj)
+	{
+		size_t elements = m_rels_left[index].ways[obj].Size();
 
-		if (save_last)
-			object.refs.pop_back();
+		fprintf_s(out, "%Iu\n", elements);
 
-		vector<line> splits = vector<line>();
-		int inside = 0, outside = 0;
-		// Store indices of the points at which the polygon crosses the Tile border
-		for (size_t i = 0; i < object.Size();)
+		for (size_t i = 0; i < elements; i++)
 		{
-			splits.push_back(line());
-			// If point is inside the tile
-			if (m_nodes[object.refs[i]].IsInsideTile(lod_tile))
-			{
-				splits.back().first = i;
-				inside++;
+			fprintf_s(out, "%f %f\n", m_rels_left[index].ways[obj].nodes[i].lat, m_rels_left[index].ways[obj].nodes[i].lon);
+		}
+	}
 
-				i = i == object.Size() - 1 ? i : i + 1;
+	void Converter::WriteXMemberRelation(FILE *out, size_t index, size_t obj)
+	{
+		size_t elements = m_rels_left[index].relations[obj].Size();
 
-				int found = -1;
-				for (; i < object.Size() && found < 0; i++)
-				{
-					if (!m_nodes[object.refs[i]].IsInsideTile(lod_tile) || object.Size() - 1)
-						found = i - 1;
-				}
+		fprintf_s(out, "%Iu\n", elements);
 
-				splits.back().last = found;
-				splits.back().inside = true;
-			}
-			else
+		for (size_t i = 0; i < elements; i++)
+		{
+			bool is_way_node = m_rels_left[index].relations[obj].roles[i].vec == relation ? false : true;
+			switch (m_rels_left[index].relations[obj].roles[i].vec)
 			{
-				splits.back().first = i;
-				outside++;
+				case node:
+				{
+					fprintf_s(out, "%d %d %Iu %f %f\n", is_way_node, m_rels_left[index].relations[obj].roles[i].as, 1,
+						m_rels_left[index].relations[obj].nodes[i].lat, m_rels_left[index].relations[obj].nodes[i].lon);
+				} break;
+				case way:
+				{
+					fprintf_s(out, "%d %d ", is_way_node, m_rels_left[index].relations[obj].roles[i].as);
+					WriteXMemberWay(out, obj, i);
+				} break;
+				case relation:
+				{
+					fprintf_s(out, "%d %d ", is_way_node, m_rels_left[index].relations[obj].roles[i].as);
+					WriteXMemberRelation(out, obj, i);
+				} break;
+			}
+		}
+	}
 
-				double x_steps = std::floor((m_nodes[object.refs[i]].lon - m_minlon) / m_lon_step);
-				double y_steps = std::floor((m_nodes[object.refs[i]].lat - m_minlat) / m_lat_step);
+	void Converter::WriteMemberWay(FILE *out, size_t index)
+	{
+		size_t node_count = m_ways[index].Size();
 
-				size_t steps = x_steps + (sqrt(m_tilecount) * y_steps);
+		fprintf_s(out, "%Iu\n", node_count);
 
-				if (!m_nodes[object.refs[i]].IsInsideTile(m_tiles[steps]))
-					throw logic_error("Tile computation in partitioning was wrong");
+		for (size_t n = 0; n < node_count; n++)
+		{
+			WriteNode(out, m_ways[index].refs[n]);
+		}
+	}
 
-				i = i == object.Size() - 1 ? i : i + 1;
+	void Converter::WriteMemberRelation(FILE *out, size_t index)
+	{
+		size_t elements = m_relations.at(index).Size();
 
-				int found = -1;
-				for (; i < object.Size() && found < 0; i++)
-				{
-					if (!m_nodes[object.refs[i]].IsInsideTile(m_tiles[steps]) || object.Size() - 1)
-						found = i - 1;
-				}
+		fprintf_s(out, "%Iu\n", elements);
 
-				splits.back().last = found;
-				splits.back().inside = false;
+		for (size_t n = 0; n < m_relations[index].Size(); n++)
+		{
+			switch (m_relations[index].member_types[n])
+			{
+			case node:
+			{
+				fprintf_s(out, "%d %d %d\n", m_relations[index].member_types[n], m_relations[index].roles[n], 1);
+				WriteNode(out, m_relations[index].refs[n]);
+			} break;
+			case way:
+			{
+				fprintf_s(out, "%d %d", m_relations[index].member_types[n], m_relations[index].roles[n]);
+				WriteMemberWay(out, m_relations[index].refs[n]);
+			} break;
+			case relation:
+			{
+				fprintf_s(out, "%d %d", m_relations[index].member_types[n], m_relations[index].roles[n]);
+				WriteMemberRelation(out, m_relations[index].refs[n]);
+			} break;
 			}
 		}
+	}
 
-		if (inside == 0 || outside == 0)
-		{
-			logger.Log(LogLvl::error, "Computed faulty line segments for subdivision");
+	// Filenames
+	string Converter::GetDataFilename(short lod)
+	{
+		string s = m_output;
+		if (lod < 10)
+			s += string("\\lod0") + std::to_string(lod);
+		else
+			s += string("\\lod") + std::to_string(lod);
+
+		return s;
+	}
+
+	string Converter::GetLookupFilename(short lod)
+	{
+		string s = m_output;
+		if (lod < 10)
+			s += string("\\lookup0") + std::to_string(lod);
+		else
+			s += string("\\lookup") + std::to_string(lod);
+
+		return s;
+	}
+
+	string Converter::GetSegmentFilename(short lod, size_t segment)
+	{
+		return GetDataFilename(lod) + "_seg" + std::to_string(segment);
+	}
+
+	string Converter::GetSharedFilename(short lod)
+	{
+		string s = m_output;
+		if (lod < 10)
+			s += string("\\shared0") + std::to_string(lod);
+		else
+			s += string("\\shared") + std::to_string(lod);
+
+		return s;
+	}
+
+	///////////////////////////////////////////////////////
+	// Data Generalization
+	///////////////////////////////////////////////////////
+	size_t Converter::SubdivideLine(types::Tile &lod_tile, Way &object)
+	{
+		return Subdivide(lod_tile, object, false);
+	}
+
+	size_t Converter::SubdivideArea(types::Tile &lod_tile, Way &object)
+	{
+		return Subdivide(lod_tile, object, true);
+	}
+
+	size_t Converter::Subdivide(types::Tile &lod_tile, Way &object, bool area)
+	{
+		// Circular ways are clipped without their closing point
+		bool closed = object.refs.size() > 1 && object.IsCircularWay();
+		size_t count = closed ? object.refs.size() - 1 : object.refs.size();
+
+		if (count < 2 || (area && count < 3))
 			return 0;
+
+		vector<double> lats = vector<double>(count), lons = vector<double>(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			lats[i] = m_nodes[object.refs[i]].lat;
+			lons[i] = m_nodes[object.refs[i]].lon;
 		}
 
-		bool saved_one = false;
-		vector<size_t> inner_new = vector<size_t>();
-		vector<Way> inner_lines = vector<Way>();
-		vector<Way> outer_lines = vector<Way>();
+		vector<unsigned char> codes = vector<unsigned char>(count);
+		clipping::Classify(lats.data(), lons.data(), count, lod_tile, codes.data());
+
+		size_t outside = 0;
+		for (size_t i = 0; i < count; i++)
+			outside += codes[i] != clipping::out_none ? 1 : 0;
+
+		// Nothing to do if the whole way lies inside the tile
+		if (outside == 0)
+			return 0;
+
+		vector<Way> pieces = vector<Way>();
 
-		// Compute intersection points for all segments
-		for (size_t i = 0; i < splits.size(); i++)
+		if (area)
 		{
-			if (splits[i].inside)
-			{
-				// If the way we started with was an area we can store the new resulting area from all
-				// inner line as one way
-				if (save_last)
-				{
-					// Push all points that are inside the Tile into a vector
-					for (size_t at = splits[i].first; at <= splits[i].last; at++)
-					{
-						inner_new.push_back(object.refs[at]);
-					}
-				}
-				// If it was a line to begin with we can only store one of them and need to store the
-				// others as new ways
-				else
-				{
-					if (!saved_one)
-					{
-						if (!outer_lines.empty())
-							inner_new.push_back(outer_lines.back().refs.back());
+			// Parts inside the tile itself and all other tiles covered by the area
+			vector<vector<size_t>> parts = vector<vector<size_t>>();
+			vector<size_t> tiles = vector<size_t>();
+			ClipArea(object, parts, tiles);
 
-						// Push all points that are inside the Tile into a vector
-						for (size_t at = splits[i].first; at <= splits[i].last; at++)
-						{
-							inner_new.push_back(object.refs[at]);
-						}
-					}
-					else
-					{
-						if (!outer_lines.empty() && inner_lines.size() > 1)
-							inner_lines.back().refs.push_back(outer_lines.back().refs.back());
+			size_t keep = parts.size();
+			for (size_t i = 0; i < parts.size() && keep == parts.size(); i++)
+			{
+				if (&m_tiles[tiles[i]] == &lod_tile)
+					keep = i;
+			}
 
-						inner_lines.push_back(Way(vector<size_t>(), -2, object.type));
+			// Leave the area as it is if nothing of it remains inside the tile
+			if (keep == parts.size())
+				return 0;
 
-						// Push all points that are inside the Tile into a vector
-						for (size_t at = splits[i].first; at <= splits[i].last; at++)
-						{
-							inner_lines.back().refs.push_back(object.refs[at]);
-						}
-					}
-				}
+			for (size_t i = 0; i < parts.size(); i++)
+			{
+				if (i != keep)
+					pieces.push_back(Way(parts[i], -2, object.type));
 			}
-			else
+
+			object.refs = parts[keep];
+		}
+		else
+		{
+			// Alternating runs of references inside and outside of the tile,
+			// consecutive runs share the node at which the way crosses the border
+			vector<vector<size_t>> runs = vector<vector<size_t>>();
+			vector<bool> run_inside = vector<bool>();
+
+			bool inside = codes[0] == clipping::out_none;
+			runs.push_back(vector<size_t>(1, object.refs[0]));
+			run_inside.push_back(inside);
+
+			// Includes the closing segment of circular ways
+			size_t segments = closed ? count : count - 1;
+			for (size_t i = 1; i <= segments; i++)
 			{
-				bool found_before = false, found_after = false;
-				types::Way subline = types::Way(vector<size_t>(), -2, object.type);
+				size_t a = i - 1, b = i == count ? 0 : i;
+				size_t ref_b = object.refs[i];
 
-				Node intersect_one = Node(), intersect_two = Node();
-				if (save_last || i > 0)
+				// Both inside or both on the same outer side of the tile
+				if ((inside && codes[b] == clipping::out_none) || (!inside && (codes[a] & codes[b]) != 0))
 				{
-					found_before = true;
-					size_t other = splits[i].first == 0 ? (save_last ? object.Size() - 1 : 0) : splits[i].first - 1;
-					intersect_one = mathtools::Intersection(lod_tile, m_nodes[object.refs[splits[i].first]], m_nodes[object.refs[other]]);
+					runs.back().push_back(ref_b);
+					continue;
 				}
-				if (save_last || i < splits.size() - 1)
+
+				double t0 = 0.0, t1 = 1.0;
+				bool hit = clipping::ClipSegment(lats[a], lons[a], lats[b], lons[b], lod_tile, t0, t1);
+
+				// Segments only touching a corner stay outside
+				if (!inside && (!hit || t1 <= t0))
 				{
-					found_after = true;
-					size_t other = splits[i].last == object.Size() - 1 ? (save_last ? 0 : object.Size() - 1) : splits[i].last + 1;
-					intersect_two = mathtools::Intersection(lod_tile, m_nodes[object.refs[splits[i].last]], m_nodes[object.refs[other]]);
+					runs.back().push_back(ref_b);
+					continue;
 				}
 
-				if ((found_before && intersect_one.id == -1) || (found_after && intersect_two.id == -1))
+				if (!inside)
 				{
-					std::ofstream of("intersection.txt", ios_base::app);
-					of.precision(12);
-
-					of << "Object data:" << std::endl;
-					for (size_t lol = 0; lol < object.Size(); lol++)
+					size_t entry = object.refs[a];
+					if (t0 >= 1.0)
 					{
-						of << "\t lat: " << m_nodes[object.refs[lol]].lat << ", lon: " << m_nodes[object.refs[lol]].lon << std::endl;
+						entry = ref_b;
+					}
+					else if (t0 > 0.0)
+					{
+						m_nodes.push_back(Node(lats[a] + t0 * (lats[b] - lats[a]), lons[a] + t0 * (lons[b] - lons[a]), -2));
+						entry = m_nodes.size() - 1;
 					}
-					of.close();
-				}
 
-				// Push first intersection point into new objects
-				if (found_before)
-				{
-					m_nodes.push_back(intersect_one);
-					subline.refs.push_back(m_nodes.size() - 1);
-					if (save_last || (!saved_one && !inner_new.empty()))
-						inner_new.push_back(m_nodes.size() - 1);
-					else if (saved_one && !inner_lines.empty())
-						inner_lines.back().refs.push_back(m_nodes.size() - 1);
-				}
+					if (entry != runs.back().back())
+						runs.back().push_back(entry);
 
-				// Push all nodes that lie in between, as well as and including, the first and
-				// the last point into the subline's vector
-				for (size_t at = splits[i].first; at <= splits[i].last; at++)
-				{
-					subline.refs.push_back(object.refs[at]);
+					runs.push_back(vector<size_t>(1, entry));
+					run_inside.push_back(true);
+					inside = true;
 				}
 
-				// Push second intersection point into new way
-				if (found_after)
+				if (codes[b] == clipping::out_none)
 				{
-					m_nodes.push_back(intersect_two);
-					subline.refs.push_back(m_nodes.size() - 1);
+					if (ref_b != runs.back().back())
+						runs.back().push_back(ref_b);
+
+					continue;
 				}
 
-				// If the original way is an area all new ways must also be areas
-				if (save_last)
+				size_t exit = ref_b;
+				if (hit && t1 <= 0.0)
 				{
-					subline.refs.push_back(subline.refs[0]);
-					inner_new.push_back(m_nodes.size() - 1);
+					exit = object.refs[a];
 				}
-				else if (!saved_one && !inner_new.empty())
+				else if (hit && t1 < 1.0)
 				{
-					saved_one = true;
+					m_nodes.push_back(Node(lats[a] + t1 * (lats[b] - lats[a]), lons[a] + t1 * (lons[b] - lons[a]), -2));
+					exit = m_nodes.size() - 1;
 				}
 
-				// Push new outer line way into way vector
-				outer_lines.push_back(subline);
+				if (exit != runs.back().back())
+					runs.back().push_back(exit);
+
+				runs.push_back(vector<size_t>(1, exit));
+				if (exit != ref_b)
+					runs.back().push_back(ref_b);
+
+				run_inside.push_back(false);
+				inside = false;
+			}
+
+			// The way itself keeps the first part inside the tile, all other parts become new ways
+			size_t keep = runs.size();
+			for (size_t i = 0; i < runs.size() && keep == runs.size(); i++)
+			{
+				if (run_inside[i] && runs[i].size() > 1)
+					keep = i;
+			}
+
+			if (keep == runs.size())
+				return 0;
+
+			for (size_t i = 0; i < runs.size(); i++)
+			{
+				if (i != keep && runs[i].size() > 1)
+					pieces.push_back(Way(runs[i], -2, object.type));
 			}
+
+			object.refs = runs[keep];
 		}
-		if (save_last)
-			inner_new.push_back(inner_new[0]);
 
-		object.refs = inner_new;
+		object.Unrank();
+
+		// Pushing may move the way vector, so the object is not touched anymore from here
+		for (size_t i = 0; i < pieces.size(); i++)
+			m_ways.push_back(pieces[i]);
+
+		return pieces.size();
+	}
+
+	size_t Converter::ClipWay(size_t index, vector<size_t> &tiles)
+	{
+		vector<vector<size_t>> pieces = vector<vector<size_t>>();
+		tiles.clear();
+
+		if (m_ways[index].IsArea() && m_ways[index].refs.size() > 3 && m_ways[index].IsCircularWay())
+			ClipArea(m_ways[index], pieces, tiles);
+		else if (m_ways[index].refs.size() > 1)
+			ClipLine(m_ways[index], pieces, tiles);
 
-		// Push all outer ways into the way vector
-		for (size_t i = 0; i < outer_lines.size(); i++)
+		// Nothing could be clipped, the way stays where its center is
+		if (pieces.empty())
 		{
-			// TODO
-			if (outer_lines[i].Size() > 0)
-				m_ways.push_back(outer_lines[i]);
+			spatial::Box box = spatial::Box(m_ways[index], m_nodes);
+			tiles.push_back(TileIndexAt((box.min_lat + box.max_lat) / 2.0, (box.min_lon + box.max_lon) / 2.0));
+			return 0;
 		}
 
-		return outer_lines.size();
+		// Ways inside a single tile need no piece
+		if (pieces.size() == 1 && pieces[0] == m_ways[index].refs)
+			return 0;
+
+		// The way keeps its references, coarser LoDs and relations still need all of it
+		types::Type type = m_ways[index].type;
+		for (size_t i = 0; i < pieces.size(); i++)
+			m_pieces.push_back(Way(pieces[i], -2, type));
+
+		return pieces.size();
 	}
 
-	bool Converter::MergeAreas(short lod, types::Way &at, types::Way &other, vector<size_t> &store)
+	void Converter::ClipToTiles(size_t index)
 	{
-		double threshold = GetLoDAreaSize(lod) / 2.0;
-
-		// min lat, max lat, min lon, max lon
-		Extrema one[4] = { Extrema() };
-		Extrema two[4] = { Extrema() };
+		vector<size_t> tiles = vector<size_t>();
+		size_t count = ClipWay(index, tiles);
 
-		for (size_t j = 0; j < at.refs.size(); j++)
+		// Ways that were not clipped are referenced as a whole, otherwise every tile gets its piece
+		for (size_t i = 0; i < tiles.size(); i++)
 		{
-			if (m_nodes[at.refs[j]].lat <= one[0].lat)
-				one[0].Update(m_nodes[at.refs[j]], j);
-			if (m_nodes[at.refs[j]].lat >= one[1].lat)
-				one[1].Update(m_nodes[at.refs[j]], j);
-			if (m_nodes[at.refs[j]].lon <= one[2].lon)
-				one[2].Update(m_nodes[at.refs[j]], j);
-			if (m_nodes[at.refs[j]].lon >= one[3].lon)
-				one[3].Update(m_nodes[at.refs[j]], j);
+			if (tiles[i] >= m_tiles.size())
+				continue;
+
+			if (count == 0)
+				m_tiles[tiles[i]].way_refs.push_back(index);
+			else
+				m_tiles[tiles[i]].piece_refs.push_back(m_pieces.size() - count + i);
 		}
-		for (size_t j = 0; j < other.refs.size(); j++)
+	}
+
+	void Converter::ClipLine(Way &object, vector<vector<size_t>> &pieces, vector<size_t> &tiles)
+	{
+		size_t sides = std::floor(sqrt(m_tilecount));
+		vector<double> cuts = vector<double>();
+
+		pieces.push_back(vector<size_t>(1, object.refs[0]));
+		tiles.push_back(std::numeric_limits<size_t>::max());
+
+		for (size_t i = 1; i < object.refs.size(); i++)
+		{
+			// Copies, new crossing nodes may move the node vector
+			Node a = m_nodes[object.refs[i - 1]], b = m_nodes[object.refs[i]];
+
+			cuts.clear();
+			clipping::GridCrossings(a.lat, b.lat, m_minlat, m_lat_step, sides, cuts);
+			clipping::GridCrossings(a.lon, b.lon, m_minlon, m_lon_step, sides, cuts);
+			std::sort(cuts.begin(), cuts.end());
+
+			// Crossings at a corner show up twice, the segment end is always the last cut
+			size_t valid = 0;
+			for (size_t c = 0; c < cuts.size(); c++)
+			{
+				if (cuts[c] < 1.0 - START && (valid == 0 || cuts[c] - cuts[valid - 1] > START))
+					cuts[valid++] = cuts[c];
+			}
+			cuts.resize(valid);
+			cuts.push_back(1.0);
+
+			double from = 0.0;
+			for (size_t c = 0; c < cuts.size(); c++)
+			{
+				double mid = (from + cuts[c]) / 2.0;
+				size_t tile = TileIndexAt(a.lat + mid * (b.lat - a.lat), a.lon + mid * (b.lon - a.lon));
+
+				// Consecutive pieces share the node at which the way enters the next tile
+				if (tile != tiles.back())
+				{
+					if (pieces.back().size() > 1)
+					{
+						pieces.push_back(vector<size_t>(1, pieces.back().back()));
+						tiles.push_back(tile);
+					}
+					else
+					{
+						tiles.back() = tile;
+					}
+				}
+
+				if (cuts[c] >= 1.0)
+				{
+					pieces.back().push_back(object.refs[i]);
+				}
+				else
+				{
+					m_nodes.push_back(Node(a.lat + cuts[c] * (b.lat - a.lat), a.lon + cuts[c] * (b.lon - a.lon), -2));
+					pieces.back().push_back(m_nodes.size() - 1);
+				}
+
+				from = cuts[c];
+			}
+		}
+
+		// Tiles that are not part of this batch are not written
+		for (size_t i = tiles.size(); i > 0; i--)
+		{
+			if (tiles[i - 1] >= m_tiles.size())
+			{
+				pieces.erase(pieces.begin() + (i - 1));
+				tiles.erase(tiles.begin() + (i - 1));
+			}
+		}
+	}
+
+	void Converter::ClipArea(Way &object, vector<vector<size_t>> &pieces, vector<size_t> &tiles)
+	{
+		size_t sides = std::floor(sqrt(m_tilecount));
+
+		vector<clipping::Vertex> ring = vector<clipping::Vertex>(), part = vector<clipping::Vertex>();
+		ring.reserve(object.refs.size() - 1);
+		for (size_t i = 0; i + 1 < object.refs.size(); i++)
+			ring.push_back(clipping::Vertex(m_nodes[object.refs[i]].lat, m_nodes[object.refs[i]].lon, object.refs[i]));
+
+		// Neighbouring parts reuse the nodes generated on their common border
+		std::map<std::pair<long long, long long>, size_t> generated = std::map<std::pair<long long, long long>, size_t>();
+
+		spatial::Box box = spatial::Box(object.refs, m_nodes);
+		size_t first = TileIndexAt(box.min_lat, box.min_lon), last = TileIndexAt(box.max_lat, box.max_lon);
+
+		for (size_t row = first / sides; row <= last / sides; row++)
+		{
+			for (size_t col = first % sides; col <= last % sides; col++)
+			{
+				size_t t = col + row * sides;
+				if (t >= m_tiles.size())
+					continue;
+
+				clipping::ClipRing(ring, m_tiles[t], part);
+				if (part.size() < 3 || clipping::RingArea(part) <= 0.0)
+					continue;
+
+				pieces.push_back(vector<size_t>());
+				tiles.push_back(t);
+				for (size_t i = 0; i < part.size(); i++)
+				{
+					if (!part[i].IsGenerated())
+					{
+						pieces.back().push_back(part[i].index);
+						continue;
+					}
+
+					// Keyed at the resolution of PBF coordinates
+					std::pair<long long, long long> key = std::make_pair(std::llround(part[i].lat / START), std::llround(part[i].lon / START));
+					auto found = generated.find(key);
+					if (found == generated.end())
+					{
+						m_nodes.push_back(Node(part[i].lat, part[i].lon, -2));
+						found = generated.insert(std::make_pair(key, m_nodes.size() - 1)).first;
+					}
+					pieces.back().push_back(found->second);
+				}
+				pieces.back().push_back(pieces.back()[0]);
+			}
+		}
+	}
+
+	bool Converter::MergeAreas(short lod, types::Way &at, types::Way &other, vector<size_t> &store)
+	{
+		double threshold = GetLoDAreaSize(lod) / 2.0;
+
+		// min lat, max lat, min lon, max lon
+		Extrema one[4] = { Extrema() };
+		Extrema two[4] = { Extrema() };
+
+		for (size_t j = 0; j < at.refs.size(); j++)
+		{
+			if (m_nodes[at.refs[j]].lat <= one[0].lat)
+				one[0].Update(m_nodes[at.refs[j]], j);
+			if (m_nodes[at.refs[j]].lat >= one[1].lat)
+				one[1].Update(m_nodes[at.refs[j]], j);
+			if (m_nodes[at.refs[j]].lon <= one[2].lon)
+				one[2].Update(m_nodes[at.refs[j]], j);
+			if (m_nodes[at.refs[j]].lon >= one[3].lon)
+				one[3].Update(m_nodes[at.refs[j]], j);
+		}
+		for (size_t j = 0; j < other.refs.size(); j++)
 		{
 			if (m_nodes[other.refs[j]].lat <= two[0].lat)
 				two[0].Update(m_nodes[other.refs[j]], j);
@@ -2970,7 +3755,7 @@ namespace osmconverter
 	{
 		double dev = std::numeric_limits<double>::epsilon();
 		return (one.lat == two.lat || one.lat == two.lat + dev || one.lat == two.lat - dev) &&
-			   (one.lon == two.lon || one.lat == two.lon + dev || one.lon == two.lon - dev);
+			   (one.lon == two.lon || one.lon == two.lon + dev || one.lon == two.lon - dev);
 
 	}
 
@@ -2998,238 +3783,1434 @@ namespace osmconverter
 			} break;
 			case Right:
 			{
-				size_t prev = one.index > 0 ? one.index - 1 : wone.refs.size() - 1;
-				size_t next = one.index < wone.refs.size() - 1 ? one.index - 1 : 0;
+				size_t prev = one.index > 0 ? one.index - 1 : wone.refs.size() - 1;
+				size_t next = one.index < wone.refs.size() - 1 ? one.index - 1 : 0;
+
+				if (m_nodes[wone.refs[prev]].lon > m_nodes[wone.refs[next]].lon)
+				{
+					one = Extrema(m_nodes[wtwo.refs[prev]], prev);
+					next = two.index < wtwo.refs.size() - 1 ? two.index + 1 : 0;
+					two = Extrema(m_nodes[wtwo.refs[next]], next);
+				}
+				else
+				{
+					one = Extrema(m_nodes[wtwo.refs[next]], next);
+					prev = two.index > 0 ? two.index - 1 : wtwo.refs.size() - 1;
+					two = Extrema(m_nodes[wtwo.refs[prev]], prev);
+				}
+			} break;
+			case Up:
+			{
+				size_t prev = one.index > 0 ? one.index - 1 : wone.refs.size() - 1;
+				size_t next = one.index < wone.refs.size() - 1 ? one.index - 1 : 0;
+
+				if (m_nodes[wone.refs[prev]].lat > m_nodes[wone.refs[next]].lat)
+				{
+					one = Extrema(m_nodes[wtwo.refs[prev]], prev);
+					next = two.index < wtwo.refs.size() - 1 ? two.index + 1 : 0;
+					two = Extrema(m_nodes[wtwo.refs[next]], next);
+				}
+				else
+				{
+					one = Extrema(m_nodes[wtwo.refs[next]], next);
+					prev = two.index > 0 ? two.index - 1 : wtwo.refs.size() - 1;
+					two = Extrema(m_nodes[wtwo.refs[prev]], prev);
+				}
+			} break;
+			case Down:
+			{
+				size_t prev = one.index > 0 ? one.index - 1 : wone.refs.size() - 1;
+				size_t next = one.index < wone.refs.size() - 1 ? one.index - 1 : 0;
+
+				if (m_nodes[wone.refs[prev]].lat < m_nodes[wone.refs[next]].lat)
+				{
+					one = Extrema(m_nodes[wtwo.refs[prev]], prev);
+					next = two.index < wtwo.refs.size() - 1 ? two.index + 1 : 0;
+					two = Extrema(m_nodes[wtwo.refs[next]], next);
+				}
+				else
+				{
+					one = Extrema(m_nodes[wtwo.refs[next]], next);
+					prev = two.index > 0 ? two.index - 1 : wtwo.refs.size() - 1;
+					two = Extrema(m_nodes[wtwo.refs[prev]], prev);
+				}
+			} break;
+		}
+	}
+
+	std::vector<size_t> Converter::Merge(std::vector<size_t> &first, std::vector<size_t> &second, size_t a, size_t b, size_t c, size_t d)
+	{
+		vector<size_t> result = vector<size_t>();
+
+		size_t index = a;
+		while (index != b)
+		{
+			result.push_back(first[index]);
+			index = index + 1 < first.size() ? index + 1 : 0;
+		}
+		result.push_back(first[b]);
+
+		index = c;
+		while (index != d)
+		{
+			result.push_back(second[index]);
+			index = index + 1 < second.size() ? index + 1 : 0;
+		}
+		result.push_back(second[d]);
+		result.push_back(result[0]);
+
+		// Return vector containing merged polygon indices
+		return result;
+	}
+
+	///////////////////////////////////////////////////////
+	// Line Merging
+	///////////////////////////////////////////////////////
+	bool Converter::IsMergeLineType(types::Type t)
+	{
+		return IsRoadType(t) || t == waterway;
+	}
+
+	void Converter::MarkRelationMembers(vector<bool> &member, size_t count)
+	{
+		member.assign(count, false);
+		for (size_t r = 0; r < m_relations.size(); r++)
+		{
+			for (size_t m = 0; m < m_relations[r].refs.size(); m++)
+			{
+				if (m_relations[r].member_types[m] == way && m_relations[r].refs[m] < member.size())
+					member[m_relations[r].refs[m]] = true;
+			}
+		}
+	}
+
+	void Converter::MergeLines(short lod, std::vector<Way> &objects)
+	{
+		// Relation members keep their geometry
+		vector<bool> member = vector<bool>();
+		MarkRelationMembers(member, objects.size());
+
+		// Ways ending at each node
+		vector<bool> candidate = vector<bool>(objects.size(), false);
+		unordered_map<size_t, vector<size_t>> ends = unordered_map<size_t, vector<size_t>>();
+		for (size_t i = 0; i < objects.size(); i++)
+		{
+			if (objects[i].id != -1 && objects[i].id != -3 && !member[i] && IsMergeLineType(objects[i].type) &&
+				IsLoDType(lod, objects[i].type) && objects[i].refs.size() > 1 && !objects[i].IsCircularWay())
+			{
+				candidate[i] = true;
+				ends[objects[i].refs.front()].push_back(i);
+				ends[objects[i].refs.back()].push_back(i);
+			}
+		}
+
+		// Only a node at which exactly two ways of the same type end connects them,
+		// junctions of three or more ways stay as they are
+		auto partner = [&](size_t i, size_t at) {
+			auto found = ends.find(at);
+			if (found == ends.end() || found->second.size() != 2)
+				return std::numeric_limits<size_t>::max();
+
+			size_t other = found->second[0] == i ? found->second[1] : found->second[0];
+			if (other == i || !candidate[other] || objects[other].type != objects[i].type)
+				return std::numeric_limits<size_t>::max();
+
+			return other;
+		};
+
+		size_t before = 0, after = 0;
+		for (size_t i = 0; i < objects.size(); i++)
+		{
+			if (!candidate[i])
+				continue;
+
+			// Waterways have a flow direction and are only joined head to tail
+			bool directed = objects[i].type == waterway;
+			size_t joined = 0;
+
+			// Extend the way at its last node first, then at its first node
+			for (int side = 0; side < 2; side++)
+			{
+				size_t other;
+				while ((other = partner(i, side == 0 ? objects[i].refs.back() : objects[i].refs.front())) != std::numeric_limits<size_t>::max())
+				{
+					vector<size_t> &refs = objects[i].refs, &next = objects[other].refs;
+					size_t at = side == 0 ? refs.back() : refs.front();
+
+					bool aligned = side == 0 ? next.front() == at : next.back() == at;
+					if (!aligned && directed)
+						break;
+					if (!aligned)
+						std::reverse(next.begin(), next.end());
+
+					// The shared node is only stored once
+					if (side == 0)
+						refs.insert(refs.end(), next.begin() + 1, next.end());
+					else
+						refs.insert(refs.begin(), next.begin(), next.end() - 1);
+
+					// The far end of the other way is now an end of this way
+					vector<size_t> &far = ends[side == 0 ? refs.back() : refs.front()];
+					std::replace(far.begin(), far.end(), other, i);
+					ends.erase(at);
+
+					next.clear();
+					objects[other].id = -3;
+					candidate[other] = false;
+					joined++;
+				}
+			}
+
+			if (joined > 0)
+			{
+				objects[i].Unrank();
+				before += joined + 1;
+				after++;
+			}
+		}
+
+		if (before > 0)
+			logger.Log(LogLvl::info, "Merged " + std::to_string(before) + " lines into " + std::to_string(after));
+	}
+
+	///////////////////////////////////////////////////////
+	// Building Aggregation
+	///////////////////////////////////////////////////////
+	void Converter::AggregateBuildings(short lod)
+	{
+		// Buildings closer than this form a block, blocks stay smaller than a quarter of a tile
+		double step = (m_maxlat - m_minlat) / (double)m_lods[lod];
+		double distance = step / 64.0;
+		double extent = step / 4.0;
+
+		// Blocks of the previous LoD are replaced by coarser ones
+		for (size_t i = 0; i < m_ways.size(); i++)
+		{
+			if (m_ways[i].type == building_block && m_ways[i].id != -3)
+			{
+				m_ways[i].id = -3;
+				m_ways[i].refs.clear();
+			}
+		}
+
+		vector<spatial::Box> boxes = vector<spatial::Box>(m_ways.size(), spatial::Box());
+		size_t count = 0;
+		for (size_t i = 0; i < m_ways.size(); i++)
+		{
+			if (m_ways[i].id != -1 && m_ways[i].id != -3 && m_ways[i].IsHouse() && m_ways[i].refs.size() > 2)
+			{
+				boxes[i] = spatial::Box(m_ways[i], m_nodes);
+				count++;
+			}
+		}
+
+		if (count == 0)
+			return;
+
+		spatial::Grid grid = spatial::Grid();
+		grid.Build(boxes, distance);
+
+		vector<size_t> parent = vector<size_t>(boxes.size());
+		for (size_t i = 0; i < parent.size(); i++)
+			parent[i] = i;
+
+		auto find = [&parent](size_t i) {
+			while (parent[i] != i)
+			{
+				parent[i] = parent[parent[i]];
+				i = parent[i];
+			}
+			return i;
+		};
+
+		// Bounding box of every cluster, stored at its root
+		vector<spatial::Box> clusters = boxes;
+		vector<size_t> candidates = vector<size_t>();
+		for (size_t i = 0; i < boxes.size(); i++)
+		{
+			if (boxes[i].IsEmpty())
+				continue;
+
+			grid.Query(boxes[i], distance, candidates);
+			for (size_t c = 0; c < candidates.size(); c++)
+			{
+				size_t a = find(i), b = find(candidates[c]);
+				if (a == b)
+					continue;
+
+				spatial::Box merged = clusters[a];
+				merged.Extend(clusters[b]);
+				if (merged.max_lat - merged.min_lat <= extent && merged.max_lon - merged.min_lon <= extent)
+				{
+					parent[b] = a;
+					clusters[a] = merged;
+				}
+			}
+		}
+
+		unordered_map<size_t, vector<size_t>> members = unordered_map<size_t, vector<size_t>>();
+		for (size_t i = 0; i < boxes.size(); i++)
+		{
+			if (!boxes[i].IsEmpty())
+				members[find(i)].push_back(i);
+		}
+
+		// Every cluster is represented by the convex hull of all its buildings
+		size_t blocks = 0;
+		vector<size_t> points = vector<size_t>();
+		for (auto it = members.begin(); it != members.end(); it++)
+		{
+			points.clear();
+			for (size_t k = 0; k < it->second.size(); k++)
+			{
+				vector<size_t> &refs = m_ways[it->second[k]].refs;
+				points.insert(points.end(), refs.begin(), refs.end());
+			}
+			std::sort(points.begin(), points.end());
+			points.erase(std::unique(points.begin(), points.end()), points.end());
+
+			if (points.size() < 3)
+				continue;
+
+			vector<size_t> none = vector<size_t>();
+			m_ways.push_back(Way(none, -2, building_block));
+			ConstructConvexHull(points, m_ways.size() - 1);
+
+			// Drop blocks whose hull collapsed to a line
+			if (m_ways.back().refs.size() < 4)
+				m_ways.pop_back();
+			else
+				blocks++;
+		}
+
+		logger.Log(LogLvl::info, "Aggregated " + std::to_string(count) + " buildings into " + std::to_string(blocks) + " blocks");
+	}
+
+	///////////////////////////////////////////////////////
+	// Raster Generalization
+	///////////////////////////////////////////////////////
+	bool Converter::IsRasterType(types::Type t)
+	{
+		return t == green_land || t == farm_land || t == bare_land || t == forest || t == graveyard
+			|| t == industry || t == residential || t == water;
+	}
+
+	void Converter::RasterizeAreas(short lod)
+	{
+		// One raster covers all tiles of the LoD
+		size_t cells = m_lods[lod] * m_raster;
+		if (cells > C_RASTER_MAX_CELLS)
+		{
+			logger.Log(LogLvl::warning, "Raster size limited to " + std::to_string(C_RASTER_MAX_CELLS) + " cells per side");
+			cells = C_RASTER_MAX_CELLS;
+		}
+
+		double lat_cell = (m_maxlat - m_minlat) / (double)cells;
+		double lon_cell = (m_maxlon - m_minlon) / (double)cells;
+
+		// Relation members keep their geometry
+		vector<bool> member = vector<bool>();
+		MarkRelationMembers(member, m_ways.size());
+
+		// Areas are rasterized per type
+		std::map<int, vector<size_t>> areas = std::map<int, vector<size_t>>();
+		for (size_t i = 0; i < m_ways.size(); i++)
+		{
+			if (m_ways[i].id != -1 && m_ways[i].id != -3 && !member[i] && IsRasterType(m_ways[i].type) &&
+				IsLoDType(lod, m_ways[i].type) && m_ways[i].refs.size() >= 4 && m_ways[i].IsCircularWay())
+				areas[m_ways[i].type].push_back(i);
+		}
+
+		size_t before = 0, after = 0;
+		vector<unsigned char> grid = vector<unsigned char>();
+		vector<vector<size_t>> rings = vector<vector<size_t>>();
+		for (auto it = areas.begin(); it != areas.end(); it++)
+		{
+			grid.assign(cells * cells, 0);
+			for (size_t k = 0; k < it->second.size(); k++)
+			{
+				RasterizeRing(m_ways[it->second[k]].refs, grid, cells, lat_cell, lon_cell);
+
+				m_ways[it->second[k]].id = -3;
+				m_ways[it->second[k]].refs.clear();
+			}
+
+			SmoothRaster(grid, cells);
+			FillRasterHoles(grid, cells);
+			TraceRaster(grid, cells, lat_cell, lon_cell, rings);
+
+			for (size_t r = 0; r < rings.size(); r++)
+				m_ways.push_back(Way(rings[r], -2, (Type)it->first));
+
+			before += it->second.size();
+			after += rings.size();
+		}
+
+		if (before > 0)
+			logger.Log(LogLvl::info, "Rasterized " + std::to_string(before) + " areas into " + std::to_string(after));
+	}
+
+	// Sets all cells whose center lies inside the ring
+	void Converter::RasterizeRing(vector<size_t> &refs, vector<unsigned char> &grid, size_t cells, double lat_cell, double lon_cell)
+	{
+		spatial::Box box = spatial::Box(refs, m_nodes);
+
+		double first = std::ceil((box.min_lat - m_minlat) / lat_cell - 0.5);
+		double last = std::floor((box.max_lat - m_minlat) / lat_cell - 0.5);
+		first = first < 0.0 ? 0.0 : first;
+		last = last > (double)(cells - 1) ? (double)(cells - 1) : last;
+
+		vector<double> crossings = vector<double>();
+		for (double row = first; row <= last; row++)
+		{
+			double lat = m_minlat + (row + 0.5) * lat_cell;
+
+			crossings.clear();
+			for (size_t i = 1; i < refs.size(); i++)
+			{
+				Node &a = m_nodes[refs[i - 1]];
+				Node &b = m_nodes[refs[i]];
+				if ((a.lat <= lat) != (b.lat <= lat))
+					crossings.push_back(a.lon + (lat - a.lat) / (b.lat - a.lat) * (b.lon - a.lon));
+			}
+			std::sort(crossings.begin(), crossings.end());
+
+			for (size_t c = 1; c < crossings.size(); c += 2)
+			{
+				double from = std::ceil((crossings[c - 1] - m_minlon) / lon_cell - 0.5);
+				double to = std::floor((crossings[c] - m_minlon) / lon_cell - 0.5);
+				from = from < 0.0 ? 0.0 : from;
+				to = to > (double)(cells - 1) ? (double)(cells - 1) : to;
+
+				for (double col = from; col <= to; col++)
+					grid[(size_t)col + (size_t)row * cells] = 1;
+			}
+		}
+	}
+
+	// Closing followed by opening with a 3x3 neighbourhood, this fills small gaps between
+	// areas and removes areas that are smaller than a few cells
+	void Converter::SmoothRaster(vector<unsigned char> &grid, size_t cells)
+	{
+		vector<unsigned char> tmp = vector<unsigned char>(grid.size(), 0);
+
+		// Cells outside of the raster count as set when eroding so the border is kept
+		auto morph = [cells](vector<unsigned char> &from, vector<unsigned char> &to, bool dilate) {
+			for (size_t y = 0; y < cells; y++)
+			{
+				for (size_t x = 0; x < cells; x++)
+				{
+					bool result = !dilate;
+					for (int dy = -1; dy <= 1; dy++)
+					{
+						for (int dx = -1; dx <= 1; dx++)
+						{
+							if ((x == 0 && dx < 0) || (y == 0 && dy < 0) || (x + dx >= cells) || (y + dy >= cells))
+								continue;
+
+							bool set = from[(x + dx) + (y + dy) * cells] != 0;
+							result = dilate ? result || set : result && set;
+						}
+					}
+					to[x + y * cells] = result ? 1 : 0;
+				}
+			}
+		};
+
+		morph(grid, tmp, true);
+		morph(tmp, grid, false);
+		morph(grid, tmp, false);
+		morph(tmp, grid, true);
+	}
+
+	// Empty regions that can not be reached from the raster border become part of the area
+	void Converter::FillRasterHoles(vector<unsigned char> &grid, size_t cells)
+	{
+		vector<bool> outside = vector<bool>(grid.size(), false);
+		vector<size_t> stack = vector<size_t>();
+
+		for (size_t i = 0; i < cells; i++)
+		{
+			size_t border[4] = { i, i + (cells - 1) * cells, i * cells, (cells - 1) + i * cells };
+			for (size_t b = 0; b < 4; b++)
+			{
+				if (grid[border[b]] == 0 && !outside[border[b]])
+				{
+					outside[border[b]] = true;
+					stack.push_back(border[b]);
+				}
+			}
+		}
+
+		while (!stack.empty())
+		{
+			size_t cell = stack.back();
+			stack.pop_back();
+
+			size_t x = cell % cells, y = cell / cells;
+			size_t next[4] = { x > 0 ? cell - 1 : cell, x + 1 < cells ? cell + 1 : cell, y > 0 ? cell - cells : cell, y + 1 < cells ? cell + cells : cell };
+			for (size_t n = 0; n < 4; n++)
+			{
+				if (grid[next[n]] == 0 && !outside[next[n]])
+				{
+					outside[next[n]] = true;
+					stack.push_back(next[n]);
+				}
+			}
+		}
+
+		for (size_t i = 0; i < grid.size(); i++)
+		{
+			if (!outside[i])
+				grid[i] = 1;
+		}
+	}
+
+	// Follows the cell borders between set and empty cells, every ring runs clockwise
+	void Converter::TraceRaster(vector<unsigned char> &grid, size_t cells, double lat_cell, double lon_cell, vector<vector<size_t>> &rings)
+	{
+		// Border piece with the set cell to its right, directions are east, south, west and north
+		struct edge {
+			size_t from, to;
+			int dir;
+			bool used;
+		};
+
+		size_t side = cells + 1;
+		auto at = [&grid, cells](long long x, long long y) {
+			return x >= 0 && y >= 0 && x < (long long)cells && y < (long long)cells && grid[x + y * cells] != 0;
+		};
+
+		vector<edge> edges = vector<edge>();
+		unordered_map<size_t, vector<size_t>> outgoing = unordered_map<size_t, vector<size_t>>();
+		for (long long y = 0; y < (long long)cells; y++)
+		{
+			for (long long x = 0; x < (long long)cells; x++)
+			{
+				if (!at(x, y))
+					continue;
+
+				size_t sw = x + y * side, se = sw + 1, nw = sw + side, ne = nw + 1;
+				if (!at(x, y + 1))
+					edges.push_back(edge{ nw, ne, 0, false });
+				if (!at(x + 1, y))
+					edges.push_back(edge{ ne, se, 1, false });
+				if (!at(x, y - 1))
+					edges.push_back(edge{ se, sw, 2, false });
+				if (!at(x - 1, y))
+					edges.push_back(edge{ sw, nw, 3, false });
+			}
+		}
+
+		for (size_t e = 0; e < edges.size(); e++)
+			outgoing[edges[e].from].push_back(e);
+
+		rings.clear();
+		unordered_map<size_t, size_t> vertices = unordered_map<size_t, size_t>();
+		for (size_t e = 0; e < edges.size(); e++)
+		{
+			if (edges[e].used)
+				continue;
+
+			vector<size_t> path = vector<size_t>();
+			size_t current = e;
+			while (!edges[current].used)
+			{
+				edges[current].used = true;
+				path.push_back(current);
+
+				// Where two rings touch diagonally the right turn keeps them apart
+				size_t next = current;
+				vector<size_t> &options = outgoing[edges[current].to];
+				for (int turn = 1; turn >= -1 && next == current; turn--)
+				{
+					for (size_t o = 0; o < options.size(); o++)
+					{
+						if (!edges[options[o]].used && edges[options[o]].dir == (edges[current].dir + turn + 4) % 4)
+							next = options[o];
+					}
+				}
+
+				if (next == current)
+					break;
+
+				current = next;
+			}
+
+			// Corners of the ring, straight runs are collapsed
+			vector<size_t> corners = vector<size_t>();
+			for (size_t i = 0; i < path.size(); i++)
+			{
+				if (edges[path[i]].dir != edges[path[(i + 1) % path.size()]].dir)
+					corners.push_back(edges[path[i]].to);
+			}
+
+			// Holes run counterclockwise, they were filled before so only slivers are left
+			double area = 0.0;
+			for (size_t i = 0; i < corners.size(); i++)
+			{
+				size_t a = corners[i], b = corners[(i + 1) % corners.size()];
+				area += (double)(a % side) * (double)(b / side) - (double)(b % side) * (double)(a / side);
+			}
+
+			if (corners.size() < 4 || area >= 0.0)
+				continue;
+
+			vector<size_t> ring = vector<size_t>();
+			for (size_t i = 0; i <= corners.size(); i++)
+			{
+				size_t corner = corners[i % corners.size()];
+				auto found = vertices.find(corner);
+				if (found == vertices.end())
+				{
+					m_nodes.push_back(Node(m_minlat + (double)(corner / side) * lat_cell, m_minlon + (double)(corner % side) * lon_cell, -2));
+					found = vertices.insert(std::make_pair(corner, m_nodes.size() - 1)).first;
+				}
+				ring.push_back(found->second);
+			}
+
+			rings.push_back(ring);
+		}
+	}
+
+	///////////////////////////////////////////////////////
+	// Area Dissolving
+	///////////////////////////////////////////////////////
+	bool Converter::IsDissolveType(types::Type t)
+	{
+		return t == forest || t == farm_land || t == residential;
+	}
+
+	void Converter::DissolveAreas(short lod, std::vector<Way> &objects)
+	{
+		// Vertices closer than this are treated as one
+		double tolerance = std::sqrt(GetLoDAreaSize(lod)) / 16.0;
+
+		// Relation members keep their geometry
+		vector<bool> member = vector<bool>();
+		MarkRelationMembers(member, objects.size());
+
+		vector<spatial::Box> boxes = vector<spatial::Box>(objects.size(), spatial::Box());
+		double extent = 0.0;
+		size_t count = 0;
+		for (size_t i = 0; i < objects.size(); i++)
+		{
+			if (objects[i].id != -1 && objects[i].id != -3 && !member[i] && IsDissolveType(objects[i].type) &&
+				IsLoDType(lod, objects[i].type) && objects[i].refs.size() >= 4 && objects[i].IsCircularWay())
+			{
+				boxes[i] = spatial::Box(objects[i], m_nodes);
+				extent += std::fmax(boxes[i].max_lat - boxes[i].min_lat, boxes[i].max_lon - boxes[i].min_lon);
+				count++;
+			}
+		}
+
+		if (count < 2)
+			return;
+
+		spatial::Grid grid = spatial::Grid();
+		grid.Build(boxes, extent / (double)count + tolerance);
+
+		// Areas of the same type whose boxes are within tolerance end up in one cluster
+		vector<size_t> parent = vector<size_t>(objects.size());
+		for (size_t i = 0; i < parent.size(); i++)
+			parent[i] = i;
+
+		auto find = [&parent](size_t i) {
+			while (parent[i] != i)
+			{
+				parent[i] = parent[parent[i]];
+				i = parent[i];
+			}
+			return i;
+		};
+
+		vector<size_t> candidates = vector<size_t>();
+		for (size_t i = 0; i < objects.size(); i++)
+		{
+			if (boxes[i].IsEmpty())
+				continue;
+
+			grid.Query(boxes[i], tolerance, candidates);
+			for (size_t c = 0; c < candidates.size(); c++)
+			{
+				if (candidates[c] != i && objects[candidates[c]].type == objects[i].type)
+				{
+					size_t a = find(i), b = find(candidates[c]);
+					if (a != b)
+						parent[a < b ? b : a] = a < b ? a : b;
+				}
+			}
+		}
+		grid.Clear();
+
+		unordered_map<size_t, vector<size_t>> clusters = unordered_map<size_t, vector<size_t>>();
+		for (size_t i = 0; i < objects.size(); i++)
+		{
+			if (!boxes[i].IsEmpty())
+				clusters[find(i)].push_back(i);
+		}
+
+		size_t before = 0, after = 0;
+		for (auto it = clusters.begin(); it != clusters.end(); it++)
+		{
+			vector<size_t> &cluster = it->second;
+			if (cluster.size() < 2)
+				continue;
+
+			vector<vector<size_t>> rings = UnionAreas(objects, cluster, tolerance);
+			// Keep the original areas if the union failed or split into more rings than there are
+			// areas to hold them, dropping rings would lose geometry
+			if (rings.empty() || rings.size() > cluster.size())
+				continue;
+
+			// The largest rings replace the first areas of the cluster, all others are merged away
+			for (size_t k = 0; k < cluster.size(); k++)
+			{
+				if (k < rings.size())
+				{
+					objects[cluster[k]].refs = rings[k];
+					objects[cluster[k]].Unrank();
+				}
+				else
+				{
+					objects[cluster[k]].id = -3;
+				}
+			}
+
+			before += cluster.size();
+			after += rings.size();
+		}
+
+		if (before > 0)
+			logger.Log(LogLvl::info, "Dissolved " + std::to_string(before) + " areas into " + std::to_string(after));
+	}
+
+	std::vector<std::vector<size_t>> Converter::UnionAreas(std::vector<Way> &objects, std::vector<size_t> &cluster, double tolerance)
+	{
+		// Directed edge of a clockwise ring, the inside lies to its right
+		struct segment {
+			size_t from, to, ring;
+		};
+
+		unordered_map<long long, vector<size_t>> snap = unordered_map<long long, vector<size_t>>();
+
+		// Snap all areas and orient them clockwise
+		vector<vector<size_t>> rings = vector<vector<size_t>>();
+		for (size_t c = 0; c < cluster.size(); c++)
+		{
+			vector<size_t> ring = vector<size_t>();
+			for (size_t i = 0; i < objects[cluster[c]].refs.size(); i++)
+			{
+				size_t index = SnapNode(objects[cluster[c]].refs[i], tolerance, snap);
+				if (ring.empty() || ring.back() != index)
+					ring.push_back(index);
+			}
+
+			if (ring.size() > 1 && ring.front() != ring.back())
+				ring.push_back(ring.front());
+
+			// Areas that collapsed while snapping are dropped
+			double orientation = ring.size() < 4 ? 0.0 : RingOrientation(ring);
+			if (orientation == 0.0)
+				continue;
+
+			if (orientation < 0.0)
+				std::reverse(ring.begin(), ring.end());
+
+			rings.push_back(ring);
+		}
+
+		vector<segment> edges = vector<segment>();
+		vector<spatial::Box> edge_boxes = vector<spatial::Box>();
+		double length = 0.0;
+		for (size_t r = 0; r < rings.size(); r++)
+		{
+			for (size_t i = 0; i + 1 < rings[r].size(); i++)
+			{
+				edges.push_back(segment{ rings[r][i], rings[r][i + 1], r });
+				vector<size_t> ends = { rings[r][i], rings[r][i + 1] };
+				edge_boxes.push_back(spatial::Box(ends, m_nodes));
+				length += m_nodes[rings[r][i]].Distance(m_nodes[rings[r][i + 1]]);
+			}
+		}
+
+		if (edges.empty())
+			return vector<vector<size_t>>();
+
+		spatial::Grid edge_grid = spatial::Grid();
+		edge_grid.Build(edge_boxes, length / (double)edges.size() + tolerance);
+
+		// Nodes at which each edge has to be split, keyed by their position along the edge
+		vector<vector<std::pair<double, size_t>>> splits = vector<vector<std::pair<double, size_t>>>(edges.size());
+		vector<size_t> candidates = vector<size_t>();
+		for (size_t e = 0; e < edges.size(); e++)
+		{
+			edge_grid.Query(edge_boxes[e], tolerance, candidates);
+			for (size_t k = 0; k < candidates.size(); k++)
+			{
+				size_t o = candidates[k];
+				if (o <= e)
+					continue;
+
+				size_t a = edges[e].from, b = edges[e].to;
+				size_t c = edges[o].from, d = edges[o].to;
+
+				// Endpoints lying on the other edge (touching and overlapping edges)
+				double dist, pos;
+				if (c != a && c != b && (pos = SegmentPosition(a, b, c, dist)) > 0.0 && pos < 1.0 && dist <= tolerance)
+					splits[e].push_back(std::make_pair(pos, c));
+				if (d != a && d != b && (pos = SegmentPosition(a, b, d, dist)) > 0.0 && pos < 1.0 && dist <= tolerance)
+					splits[e].push_back(std::make_pair(pos, d));
+				if (a != c && a != d && (pos = SegmentPosition(c, d, a, dist)) > 0.0 && pos < 1.0 && dist <= tolerance)
+					splits[o].push_back(std::make_pair(pos, a));
+				if (b != c && b != d && (pos = SegmentPosition(c, d, b, dist)) > 0.0 && pos < 1.0 && dist <= tolerance)
+					splits[o].push_back(std::make_pair(pos, b));
+
+				if (a == c || a == d || b == c || b == d)
+					continue;
+
+				// Proper crossing of both edges
+				vec2 va = vec2(m_nodes[a]), vb = vec2(m_nodes[b]), vc = vec2(m_nodes[c]), vd = vec2(m_nodes[d]);
+				double o1 = vec2::Orientation(va, vb, vc), o2 = vec2::Orientation(va, vb, vd);
+				double o3 = vec2::Orientation(vc, vd, va), o4 = vec2::Orientation(vc, vd, vb);
+				if (!((o1 < 0.0 && o2 > 0.0) || (o1 > 0.0 && o2 < 0.0)) || !((o3 < 0.0 && o4 > 0.0) || (o3 > 0.0 && o4 < 0.0)))
+					continue;
+
+				double t = o3 / (o3 - o4);
+				double u = o1 / (o1 - o2);
+				double lat = va.y + t * (vb.y - va.y);
+				double lon = va.x + t * (vb.x - va.x);
+
+				// Crossings next to an endpoint were already handled as touching
+				Node crossing = Node(lat, lon, -2);
+				if (crossing.Distance(m_nodes[a]) <= tolerance || crossing.Distance(m_nodes[b]) <= tolerance ||
+					crossing.Distance(m_nodes[c]) <= tolerance || crossing.Distance(m_nodes[d]) <= tolerance)
+					continue;
+
+				m_nodes.push_back(crossing);
+				size_t index = SnapNode(m_nodes.size() - 1, tolerance, snap);
+				if (index != m_nodes.size() - 1)
+					m_nodes.pop_back();
+
+				splits[e].push_back(std::make_pair(t, index));
+				splits[o].push_back(std::make_pair(u, index));
+			}
+		}
+		edge_grid.Clear();
+
+		// Split all edges into pieces that no longer cross or touch another edge
+		vector<segment> pieces = vector<segment>();
+		for (size_t e = 0; e < edges.size(); e++)
+		{
+			std::sort(splits[e].begin(), splits[e].end());
+
+			size_t last = edges[e].from;
+			for (size_t s = 0; s < splits[e].size(); s++)
+			{
+				if (splits[e][s].second != last)
+				{
+					pieces.push_back(segment{ last, splits[e][s].second, edges[e].ring });
+					last = splits[e][s].second;
+				}
+			}
+
+			if (edges[e].to != last)
+				pieces.push_back(segment{ last, edges[e].to, edges[e].ring });
+		}
+
+		unsigned long long node_count = (unsigned long long)m_nodes.size();
+		unordered_map<unsigned long long, size_t> directed = unordered_map<unsigned long long, size_t>();
+		for (size_t p = 0; p < pieces.size(); p++)
+			directed[pieces[p].from * node_count + pieces[p].to]++;
+
+		vector<spatial::Box> ring_boxes = vector<spatial::Box>();
+		for (size_t r = 0; r < rings.size(); r++)
+			ring_boxes.push_back(spatial::Box(rings[r], m_nodes));
+
+		spatial::Grid ring_grid = spatial::Grid();
+		ring_grid.Build(ring_boxes, tolerance);
+
+		// A piece is part of the outline if nothing lies directly to its left
+		vector<segment> outline = vector<segment>();
+		for (size_t p = 0; p < pieces.size(); p++)
+		{
+			// Shared borders of neighbouring areas run in opposite directions
+			if (directed.find(pieces[p].to * node_count + pieces[p].from) != directed.end())
+				continue;
+
+			// Identical borders of overlapping areas are only kept once
+			auto it = directed.find(pieces[p].from * node_count + pieces[p].to);
+			if (it->second == 0)
+				continue;
+
+			Node &from = m_nodes[pieces[p].from];
+			Node &to = m_nodes[pieces[p].to];
+			double dx = to.lon - from.lon, dy = to.lat - from.lat;
+			double len = std::sqrt(dx * dx + dy * dy);
+			if (len == 0.0)
+				continue;
+
+			double offset = tolerance * 0.01;
+			double lat = (from.lat + to.lat) / 2.0 + dx / len * offset;
+			double lon = (from.lon + to.lon) / 2.0 - dy / len * offset;
+
+			spatial::Box point = spatial::Box(lat, lat, lon, lon);
+			ring_grid.Query(point, 0.0, candidates);
+
+			bool inside = false;
+			for (size_t k = 0; k < candidates.size() && !inside; k++)
+			{
+				if (candidates[k] != pieces[p].ring)
+					inside = IsInsideRing(lat, lon, rings[candidates[k]]);
+			}
+
+			if (!inside)
+			{
+				it->second = 0;
+				outline.push_back(pieces[p]);
+			}
+		}
+		ring_grid.Clear();
+
+		// Chain the outline into rings
+		unordered_map<size_t, vector<size_t>> outgoing = unordered_map<size_t, vector<size_t>>();
+		for (size_t o = 0; o < outline.size(); o++)
+			outgoing[outline[o].from].push_back(o);
+
+		const double two_pi = 2.0 * std::acos(-1.0);
+		vector<bool> used = vector<bool>(outline.size(), false);
+		vector<vector<size_t>> result = vector<vector<size_t>>();
+		vector<double> areas = vector<double>();
+		for (size_t o = 0; o < outline.size(); o++)
+		{
+			if (used[o])
+				continue;
+
+			vector<size_t> ring = vector<size_t>();
+			ring.push_back(outline[o].from);
+
+			size_t current = o;
+			bool closed = false;
+			while (true)
+			{
+				used[current] = true;
+				size_t at = outline[current].to;
+				ring.push_back(at);
 
-				if (m_nodes[wone.refs[prev]].lon > m_nodes[wone.refs[next]].lon)
+				if (at == outline[o].from)
 				{
-					one = Extrema(m_nodes[wtwo.refs[prev]], prev);
-					next = two.index < wtwo.refs.size() - 1 ? two.index + 1 : 0;
-					two = Extrema(m_nodes[wtwo.refs[next]], next);
+					closed = true;
+					break;
 				}
-				else
+
+				// Where several pieces leave a node take the first one clockwise from where we came from
+				double back = std::atan2(m_nodes[outline[current].from].lat - m_nodes[at].lat, m_nodes[outline[current].from].lon - m_nodes[at].lon);
+				size_t next = std::numeric_limits<size_t>::max();
+				double best = std::numeric_limits<double>::max();
+				vector<size_t> &leaving = outgoing[at];
+				for (size_t l = 0; l < leaving.size(); l++)
 				{
-					one = Extrema(m_nodes[wtwo.refs[next]], next);
-					prev = two.index > 0 ? two.index - 1 : wtwo.refs.size() - 1;
-					two = Extrema(m_nodes[wtwo.refs[prev]], prev);
+					if (used[leaving[l]])
+						continue;
+
+					double angle = back - std::atan2(m_nodes[outline[leaving[l]].to].lat - m_nodes[at].lat, m_nodes[outline[leaving[l]].to].lon - m_nodes[at].lon);
+					while (angle <= 0.0)
+						angle += two_pi;
+					while (angle > two_pi)
+						angle -= two_pi;
+
+					if (angle < best)
+					{
+						best = angle;
+						next = leaving[l];
+					}
 				}
-			} break;
-			case Up:
+
+				if (next == std::numeric_limits<size_t>::max())
+					break;
+
+				current = next;
+			}
+
+			// Holes are filled, broken and degenerated rings are dropped
+			double orientation = closed && ring.size() >= 4 ? RingOrientation(ring) : 0.0;
+			if (orientation > 0.0)
 			{
-				size_t prev = one.index > 0 ? one.index - 1 : wone.refs.size() - 1;
-				size_t next = one.index < wone.refs.size() - 1 ? one.index - 1 : 0;
+				result.push_back(ring);
+				areas.push_back(orientation);
+			}
+		}
 
-				if (m_nodes[wone.refs[prev]].lat > m_nodes[wone.refs[next]].lat)
-				{
-					one = Extrema(m_nodes[wtwo.refs[prev]], prev);
-					next = two.index < wtwo.refs.size() - 1 ? two.index + 1 : 0;
-					two = Extrema(m_nodes[wtwo.refs[next]], next);
-				}
-				else
-				{
-					one = Extrema(m_nodes[wtwo.refs[next]], next);
-					prev = two.index > 0 ? two.index - 1 : wtwo.refs.size() - 1;
-					two = Extrema(m_nodes[wtwo.refs[prev]], prev);
-				}
-			} break;
-			case Down:
+		// Largest rings first
+		vector<size_t> order = vector<size_t>(result.size());
+		for (size_t i = 0; i < order.size(); i++)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [&areas](size_t a, size_t b) { return areas[a] > areas[b]; });
+
+		vector<vector<size_t>> sorted = vector<vector<size_t>>();
+		for (size_t i = 0; i < order.size(); i++)
+			sorted.push_back(result[order[i]]);
+
+		return sorted;
+	}
+
+	size_t Converter::SnapNode(size_t index, double tolerance, std::unordered_map<long long, std::vector<size_t>> &snap)
+	{
+		long long row = (long long)std::floor(m_nodes[index].lat / tolerance);
+		long long col = (long long)std::floor(m_nodes[index].lon / tolerance);
+
+		// Look for an already snapped node within tolerance in the surrounding cells
+		for (long long r = row - 1; r <= row + 1; r++)
+		{
+			for (long long c = col - 1; c <= col + 1; c++)
 			{
-				size_t prev = one.index > 0 ? one.index - 1 : wone.refs.size() - 1;
-				size_t next = one.index < wone.refs.size() - 1 ? one.index - 1 : 0;
+				auto it = snap.find(r * 1000003LL + c);
+				if (it == snap.end())
+					continue;
 
-				if (m_nodes[wone.refs[prev]].lat < m_nodes[wone.refs[next]].lat)
+				for (size_t i = 0; i < it->second.size(); i++)
 				{
-					one = Extrema(m_nodes[wtwo.refs[prev]], prev);
-					next = two.index < wtwo.refs.size() - 1 ? two.index + 1 : 0;
-					two = Extrema(m_nodes[wtwo.refs[next]], next);
-				}
-				else
-				{
-					one = Extrema(m_nodes[wtwo.refs[next]], next);
-					prev = two.index > 0 ? two.index - 1 : wtwo.refs.size() - 1;
-					two = Extrema(m_nodes[wtwo.refs[prev]], prev);
+					if (it->second[i] == index || m_nodes[index].Distance(m_nodes[it->second[i]]) <= tolerance)
+						return it->second[i];
 				}
-			} break;
+			}
 		}
+
+		snap[row * 1000003LL + col].push_back(index);
+		return index;
 	}
 
-	std::vector<size_t> Converter::Merge(std::vector<size_t> &first, std::vector<size_t> &second, size_t a, size_t b, size_t c, size_t d)
+	double Converter::SegmentPosition(size_t start, size_t end, size_t at, double &distance)
 	{
-		vector<size_t> result = vector<size_t>();
+		double dx = m_nodes[end].lon - m_nodes[start].lon;
+		double dy = m_nodes[end].lat - m_nodes[start].lat;
+		double px = m_nodes[at].lon - m_nodes[start].lon;
+		double py = m_nodes[at].lat - m_nodes[start].lat;
 
-		size_t index = a;
-		while (index != b)
+		double len = dx * dx + dy * dy;
+		if (len == 0.0)
 		{
-			result.push_back(first[index]);
-			index = index + 1 < first.size() ? index + 1 : 0;
+			distance = std::sqrt(px * px + py * py);
+			return 0.0;
 		}
-		result.push_back(first[b]);
 
-		index = c;
-		while (index != d)
+		// Position of the projected point, 0 at start and 1 at end
+		double t = (px * dx + py * dy) / len;
+		double cx = t < 0.0 ? 0.0 : (t > 1.0 ? 1.0 : t);
+		distance = std::sqrt(pow(px - cx * dx, 2.0) + pow(py - cx * dy, 2.0));
+
+		return t;
+	}
+
+	double Converter::RingOrientation(std::vector<size_t> &ring)
+	{
+		// Positive for clockwise and negative for counter clockwise rings
+		double sum = 0.0;
+		for (size_t i = 0; i + 1 < ring.size(); i++)
+			sum += (m_nodes[ring[i + 1]].lon - m_nodes[ring[i]].lon) * (m_nodes[ring[i + 1]].lat + m_nodes[ring[i]].lat);
+
+		return sum;
+	}
+
+	bool Converter::IsInsideRing(double lat, double lon, std::vector<size_t> &ring)
+	{
+		bool inside = false;
+		for (size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++)
 		{
-			result.push_back(second[index]);
-			index = index + 1 < second.size() ? index + 1 : 0;
+			Node &a = m_nodes[ring[i]];
+			Node &b = m_nodes[ring[j]];
+			if ((a.lat > lat) != (b.lat > lat) && lon < (b.lon - a.lon) * (lat - a.lat) / (b.lat - a.lat) + a.lon)
+				inside = !inside;
 		}
-		result.push_back(second[d]);
-		result.push_back(result[0]);
-
-		// Return vector containing merged polygon indices
-		return result;
+		return inside;
 	}
 
+	// Andrew's monotone chain, the hull runs counterclockwise and is stored as a closed polygon
 	void Converter::ConstructConvexHull(std::vector<size_t> &points, size_t index)
 	{
-		vector<size_t> hull = vector<size_t>();
+		vector<Node> &nodes = m_nodes;
+		auto less = [&nodes](size_t a, size_t b) {
+			return nodes[a].lon < nodes[b].lon || (nodes[a].lon == nodes[b].lon && nodes[a].lat < nodes[b].lat);
+		};
+		auto same = [&nodes](size_t a, size_t b) {
+			return nodes[a].lon == nodes[b].lon && nodes[a].lat == nodes[b].lat;
+		};
+		// Positive if the turn from o over a to b is counterclockwise
+		auto cross = [&nodes](size_t o, size_t a, size_t b) {
+			return (nodes[a].lon - nodes[o].lon) * (nodes[b].lat - nodes[o].lat) - (nodes[a].lat - nodes[o].lat) * (nodes[b].lon - nodes[o].lon);
+		};
+
+		vector<size_t> sorted = vector<size_t>(points.begin(), points.end());
+		if (!std::is_sorted(sorted.begin(), sorted.end(), less))
+			std::sort(sorted.begin(), sorted.end(), less);
+		sorted.erase(std::unique(sorted.begin(), sorted.end(), same), sorted.end());
 
-		size_t left = 0;
-		for (size_t i = 1; i < points.size(); i++)
+		vector<size_t> hull = vector<size_t>();
+		if (sorted.size() < 3)
 		{
-			if (m_nodes[points[i]].lon < m_nodes[points[left]].lon)
-				left = i;
+			hull = sorted;
 		}
-
-		size_t p = left, q;
-		do
+		else
 		{
-			hull.push_back(points[p]);
+			hull.resize(2 * sorted.size());
+			size_t k = 0;
+
+			// Lower hull, collinear points are dropped
+			for (size_t i = 0; i < sorted.size(); i++)
+			{
+				while (k >= 2 && cross(hull[k - 2], hull[k - 1], sorted[i]) <= 0.0)
+					k--;
+				hull[k++] = sorted[i];
+			}
 
-			q = (p + 1) % points.size();
-			for (size_t i = 0; i < points.size(); i++)
+			// Upper hull, it ends with the first point which closes the polygon
+			for (size_t i = sorted.size() - 1, lower = k + 1; i > 0; i--)
 			{
-				if (IsLeft(points[p], points[i], points[q]) < 0)
-					q = i;
+				while (k >= lower && cross(hull[k - 2], hull[k - 1], sorted[i - 1]) <= 0.0)
+					k--;
+				hull[k++] = sorted[i - 1];
 			}
 
-			p = q;
+			hull.resize(k - 1);
+		}
 
-		} while (p != left);
+		if (!hull.empty())
+			hull.push_back(hull[0]);
 
 		m_ways[index].refs = hull;
+		m_ways[index].Unrank();
 	}
 
-	double Converter::IsLeft(size_t start, size_t end, size_t at)
+	void Converter::HullAreas(short lod)
 	{
-		vec2 s = vec2(m_nodes[start]);
-		vec2 e = vec2(m_nodes[end]);
-		vec2 a = vec2(m_nodes[at]);
+		double extent = (m_maxlat - m_minlat) / (double)m_lods[lod] / C_HULL_FRACTION;
+
+		// Relation members keep their geometry
+		vector<bool> member = vector<bool>();
+		MarkRelationMembers(member, m_ways.size());
+
+		size_t count = 0;
+		vector<size_t> points = vector<size_t>();
+		for (size_t i = 0; i < m_ways.size(); i++)
+		{
+			Way &object = m_ways[i];
+			if (object.id == -1 || object.id == -3 || member[i] || !object.IsArea() || !IsLoDType(lod, object.type) ||
+				object.refs.size() <= 5 || !object.IsCircularWay())
+				continue;
+
+			spatial::Box box = spatial::Box(object, m_nodes);
+			if (box.max_lat - box.min_lat > extent || box.max_lon - box.min_lon > extent)
+				continue;
+
+			points.assign(object.refs.begin(), object.refs.end() - 1);
+			ConstructConvexHull(points, i);
+
+			// Hulls that collapsed to a line drop the area
+			if (object.refs.size() < 4)
+			{
+				object.id = -3;
+				object.refs.clear();
+			}
+
+			count++;
+		}
 
-		return vec2::Orientation(s, e, a);
+		if (count > 0)
+			logger.Log(LogLvl::info, "Replaced " + std::to_string(count) + " small areas by their convex hull");
 	}
 
-	std::vector<size_t> Converter::DouglasPeucker(std::vector<size_t> line, double epsilon)
+	void Converter::RankWays()
 	{
-		vector<size_t> result = vector<size_t>();
-		vector<size_t> tmp1 = vector<size_t>();
-		vector<size_t> tmp2 = vector<size_t>();
+		// Eager ranking only pays off if the finest simplified LoD filters by importance,
+		// otherwise ways are ranked on demand once their references are final
+		switch (m_simplify[C_MAX_LOD - 1])
+		{
+			case douglas_peucker: case visvalingam_whyatt: break;
+			default: return;
+		}
+
+		logger.Log(LogLvl::info, "Ranking way vertices");
+
+		for (size_t i = 0; i < m_ways.size(); i++)
+		{
+			if (m_ways[i].id == -1 || m_ways[i].id == -3 || m_ways[i].refs.empty())
+				continue;
+
+			// Ways made of shared borders only rank their chains
+			if (m_borders.find(i) != m_borders.end())
+				continue;
+
+			if (m_ways[i].IsRanked() && m_ways[i].ranking == m_simplify[C_MAX_LOD - 1])
+				continue;
+
+			if (m_simplify[C_MAX_LOD - 1] == douglas_peucker)
+				simplification::RankWay<simplification::DouglasPeucker>(m_ways[i], m_nodes);
+			else
+				simplification::RankWay<simplification::VisvalingamWhyatt>(m_ways[i], m_nodes);
+		}
+
+		for (size_t c = 0; c < m_chains.size(); c++)
+		{
+			if (m_simplify[C_MAX_LOD - 1] == douglas_peucker)
+				simplification::RankWay<simplification::DouglasPeucker>(m_chains[c], m_nodes);
+			else
+				simplification::RankWay<simplification::VisvalingamWhyatt>(m_chains[c], m_nodes);
+		}
+	}
 
-		size_t index = 0;
-		double max = 0.0;
+	///////////////////////////////////////////////////////
+	// Shared Borders
+	///////////////////////////////////////////////////////
 
-		if (line.empty())
-			throw length_error("Tried to simplify empty line");
+	// Areas and members of area relations are split into chains at every node where the set of
+	// ways using the border changes, chains used by more than one way are stored once
+	void Converter::BuildSharedBorders()
+	{
+		m_chains.clear();
+		m_borders.clear();
 
-		// Find point of furthest Distance from the line that is drawn between the first
-		// and the last point of the polygon/line
-		size_t end = line.size() - 1;
-		for (size_t i = 1; i < end; i++)
+		vector<bool> candidate = vector<bool>(m_ways.size(), false);
+		for (size_t r = 0; r < m_relations.size(); r++)
 		{
-			double dist = PerpendicularDistance(line, i);
-			if (dist > max)
+			if (!m_relations[r].IsArea())
+				continue;
+
+			for (size_t m = 0; m < m_relations[r].refs.size(); m++)
 			{
-				index = i;
-				max = dist;
+				if (m_relations[r].member_types[m] == way && m_relations[r].refs[m] < candidate.size())
+					candidate[m_relations[r].refs[m]] = true;
+			}
+		}
+
+		for (size_t i = 0; i < m_ways.size(); i++)
+		{
+			if (m_ways[i].id == -1 || m_ways[i].id == -3 || m_ways[i].refs.size() < 2 || m_ways[i].IsBuilding())
+				candidate[i] = false;
+			else if (m_ways[i].IsArea() && m_ways[i].IsCircularWay())
+				candidate[i] = true;
+		}
+
+		// Ways using every node, in ascending order
+		unordered_map<size_t, vector<size_t>> uses = unordered_map<size_t, vector<size_t>>();
+		for (size_t i = 0; i < m_ways.size(); i++)
+		{
+			if (!candidate[i])
+				continue;
+
+			for (size_t n = 0; n < m_ways[i].refs.size(); n++)
+			{
+				vector<size_t> &used = uses[m_ways[i].refs[n]];
+				if (used.empty() || used.back() != i)
+					used.push_back(i);
 			}
 		}
 
-		// If the maximum Distance is greater than epsilon (threshold)
-		// Account for precision loss using epsilon range around epsilon (lul)
-		if (max > (epsilon - DOUBLE_EPSILON) || max > (epsilon + DOUBLE_EPSILON))
+		std::map<vector<size_t>, size_t> known = std::map<vector<size_t>, size_t>();
+		vector<size_t> counts = vector<size_t>();
+		vector<size_t> sequence = vector<size_t>(), chain = vector<size_t>();
+		unordered_map<size_t, vector<pair<size_t, bool>>> borders = unordered_map<size_t, vector<pair<size_t, bool>>>();
+		vector<Way> chains = vector<Way>();
+
+		for (size_t i = 0; i < m_ways.size(); i++)
 		{
-			for (size_t j = 0; j <= index; j++)
+			if (!candidate[i])
+				continue;
+
+			vector<size_t> &refs = m_ways[i].refs;
+			bool closed = m_ways[i].IsCircularWay();
+			size_t size = closed ? refs.size() - 1 : refs.size();
+
+			// Ways that do not touch any other candidate keep their own simplification
+			bool shared = false;
+			vector<bool> junction = vector<bool>(size, false);
+			for (size_t n = 0; n < size; n++)
 			{
-				tmp1.push_back(line[j]);
+				vector<size_t> &used = uses[refs[n]];
+				if (used.size() < 2)
+					continue;
+
+				shared = true;
+				size_t prev = n > 0 ? n - 1 : (closed ? size - 1 : n);
+				size_t next = n + 1 < size ? n + 1 : (closed ? 0 : n);
+				junction[n] = prev == n || next == n || uses[refs[prev]] != used || uses[refs[next]] != used;
 			}
-			tmp1 = DouglasPeucker(tmp1, epsilon);
 
-			for (size_t j = index; j <= end; j++)
+			if (!shared)
+				continue;
+
+			if (!closed)
 			{
-				tmp2.push_back(line[j]);
+				junction[0] = true;
+				junction[size - 1] = true;
 			}
-			tmp2 = DouglasPeucker(tmp2, epsilon);
 
-			// Build resulting vector
-			for (size_t pos = 0; pos < tmp1.size() - 1; pos++)
+			// Rings without a junction start at their smallest node index
+			size_t start = std::find(junction.begin(), junction.end(), true) - junction.begin();
+			if (start == size)
 			{
-				result.push_back(tmp1[pos]);
+				start = std::min_element(refs.begin(), refs.begin() + size) - refs.begin();
+				junction[start] = true;
 			}
-			for (size_t pos = 0; pos < tmp2.size(); pos++)
+
+			sequence.clear();
+			for (size_t n = 0; n < size; n++)
+				sequence.push_back((start + n) % size);
+			if (closed)
+				sequence.push_back(start);
+
+			vector<pair<size_t, bool>> parts = vector<pair<size_t, bool>>();
+			chain.clear();
+			chain.push_back(refs[sequence[0]]);
+			for (size_t s = 1; s < sequence.size(); s++)
 			{
-				result.push_back(tmp2[pos]);
+				chain.push_back(refs[sequence[s]]);
+				if (!junction[sequence[s]])
+					continue;
+
+				// Chains are stored in the direction that starts with the smaller node index
+				bool reversed = chain.back() < chain.front() || (chain.back() == chain.front() && chain[chain.size() - 2] < chain[1]);
+				if (reversed)
+					std::reverse(chain.begin(), chain.end());
+
+				auto found = known.find(chain);
+				if (found == known.end())
+				{
+					found = known.insert(std::make_pair(chain, chains.size())).first;
+					chains.push_back(Way(chain, -2, m_ways[i].type));
+					counts.push_back(0);
+				}
+				counts[found->second]++;
+				parts.push_back(std::make_pair(found->second, reversed));
+
+				chain.clear();
+				chain.push_back(refs[sequence[s]]);
 			}
+
+			borders[i] = parts;
 		}
-		else
+
+		// Only ways that share at least one chain with another way are simplified by chain
+		vector<size_t> index = vector<size_t>(chains.size(), std::numeric_limits<size_t>::max());
+		size_t total = 0, shared = 0;
+		for (auto it = borders.begin(); it != borders.end(); it++)
 		{
-			result.push_back(line[0]);
-			result.push_back(line[end]);
+			if (!std::any_of(it->second.begin(), it->second.end(), [&counts](pair<size_t, bool> &p) { return counts[p.first] > 1; }))
+				continue;
+
+			for (size_t p = 0; p < it->second.size(); p++)
+			{
+				size_t &c = it->second[p].first;
+				if (index[c] == std::numeric_limits<size_t>::max())
+				{
+					index[c] = m_chains.size();
+					m_chains.push_back(chains[c]);
+					shared += counts[c] > 1 ? 1 : 0;
+				}
+				total++;
+				c = index[c];
+			}
+
+			m_borders.insert(*it);
+
+			// Rings now start at their first junction
+			AssembleBorders(it->second, m_ways[it->first].refs);
+			m_ways[it->first].Unrank();
 		}
 
-		return result;
+		if (!m_borders.empty())
+			logger.Log(LogLvl::info, "Split " + std::to_string(m_borders.size()) + " areas into " + std::to_string(m_chains.size()) +
+				" border chains, " + std::to_string(shared) + " of them shared (" + std::to_string(total) + " uses)");
+	}
+
+	void Converter::AssembleBorders(vector<pair<size_t, bool>> &parts, vector<size_t> &refs)
+	{
+		refs.clear();
+		for (size_t p = 0; p < parts.size(); p++)
+		{
+			vector<size_t> &chain = m_chains[parts[p].first].refs;
+			// Consecutive chains share their junction node
+			size_t skip = refs.empty() ? 0 : 1;
+			if (parts[p].second)
+				refs.insert(refs.end(), chain.rbegin() + skip, chain.rend());
+			else
+				refs.insert(refs.end(), chain.begin() + skip, chain.end());
+		}
 	}
 
-	std::vector<size_t> Converter::VisvalingamWhyatt(std::vector<size_t> &line, size_t keep)
+	void Converter::SimplifyBorders(short lod)
 	{
-		if (line.empty())
-			throw length_error("Tried to simplify empty line");
+		if (m_borders.empty())
+			return;
 
-		vector<size_t> tmp = vector<size_t>(line.begin(), line.end());
+		// Ways that were changed since the last LoD (dissolved, merged, clipped) fall back
+		// to being simplified on their own
+		vector<size_t> refs = vector<size_t>();
+		for (auto it = m_borders.begin(); it != m_borders.end();)
+		{
+			AssembleBorders(it->second, refs);
+			if (m_ways[it->first].id == -1 || m_ways[it->first].id == -3 || m_ways[it->first].refs != refs)
+				it = m_borders.erase(it);
+			else
+				it++;
+		}
 
-		while (tmp.size() > keep)
+		vector<bool> used = vector<bool>(m_chains.size(), false);
+		for (auto it = m_borders.begin(); it != m_borders.end(); it++)
 		{
-			priority_queue<triangle, vector<triangle>, std::greater<triangle>> tris;
+			for (size_t p = 0; p < it->second.size(); p++)
+				used[it->second[p].first] = true;
+		}
 
-			for (size_t i = 1; i < tmp.size() - 2; i += 2)
-			{
-				triangle one = triangle(i, triangle::Area(vec2(m_nodes[tmp[i - 1]]), vec2(m_nodes[tmp[i]]), vec2(m_nodes[tmp[i + 1]])));
+		for (size_t c = 0; c < m_chains.size(); c++)
+		{
+			if (used[c] && m_chains[c].refs.size() > 2)
+				SimplifyWay(lod, m_chains[c]);
+		}
 
-				if (i + 2 < tmp.size())
-				{
-					triangle two = triangle(i + 1, triangle::Area(vec2(m_nodes[tmp[i]]), vec2(m_nodes[tmp[i + 1]]), vec2(m_nodes[tmp[i + 2]])));
+		for (auto it = m_borders.begin(); it != m_borders.end(); it++)
+		{
+			Way &object = m_ways[it->first];
+			AssembleBorders(it->second, refs);
 
-					vec2 intersect = vec2();
-					if (mathtools::LineLineIntersection(
-						vec2(m_nodes[tmp[i - 1]]),
-						vec2(m_nodes[tmp[i + 1]]),
-						vec2(m_nodes[tmp[i]]),
-						vec2(m_nodes[tmp[i + 2]]), intersect))
-					{
-						double effective = triangle::Area(vec2(m_nodes[tmp[i]]), intersect, vec2(m_nodes[tmp[i + 1]]));
-						one.area -= effective;
-						two.area -= effective;
-					}
-					tris.push(two);
-				}
-				tris.push(one);
-			}
-			tmp.erase(tmp.begin() + tris.top().index);
-		}
+			// Rings that collapsed keep their last shape and are simplified on their own from now on
+			if (object.IsCircularWay() && (refs.size() < 4 || refs.front() != refs.back()))
+				continue;
 
-		return tmp;
+			object.refs = refs;
+			object.Unrank();
+		}
 	}
 
-	double Converter::PerpendicularDistance(std::vector<size_t> &polygon, size_t current)
+	template<class Algorithm>
+	void Converter::ApplySimplification(short lod, types::Way &object)
 	{
-		vec2 start = vec2(m_nodes.at(polygon[0]).lon, m_nodes.at(polygon[0]).lat);
-		vec2 end = vec2(m_nodes.at(polygon.back()).lon, m_nodes.at(polygon.back()).lat);
-		vec2 point = vec2(m_nodes.at(polygon[current]).lon, m_nodes.at(polygon[current]).lat);
+		// Vertex counts are relative to the way at the time it was ranked
+		size_t size = object.IsRanked() ? object.ranked_size : object.refs.size();
 
-		return point.PerpendicularDistance(start, end);
+		Algorithm::Simplify(object, m_nodes, GetLoDEpsilon(lod), GetLoDPercentage(lod, size));
+	}
+
+	void Converter::SimplifyWay(short lod, types::Way &object)
+	{
+		switch (m_simplify[lod])
+		{
+			case douglas_peucker: ApplySimplification<simplification::DouglasPeucker>(lod, object); break;
+			case visvalingam_whyatt: ApplySimplification<simplification::VisvalingamWhyatt>(lod, object); break;
+			case radial_distance: ApplySimplification<simplification::RadialDistance>(lod, object); break;
+			case reumann_witkam: ApplySimplification<simplification::ReumannWitkam>(lod, object); break;
+			case grid_snap: simplification::GridSnap::Simplify(object, m_nodes, GetLoDEpsilon(lod), m_snapped); break;
+			default: throw logic_error("Invalid line simplification algorithm");
+		}
 	}
 
 	bool Converter::IsLoDType(short lod, types::Type t)
 	{
 		bool base = t != Type::empty && t != Type::none;
 
+		// Building blocks replace single buildings
+		if (t == building_block)
+			return lod >= C_BLOCK_MIN_LOD && lod <= C_BLOCK_MAX_LOD;
+
 		switch (lod)
 		{
 		case 0: case 1: case 2:
@@ -3240,7 +5221,9 @@ namespace osmconverter
 			return base && ((!IsHouseType(t) && t != tree_row && t != plaza) || t == large_road); break;
 		case 11: case 12:
 			return base && t != path && t != small_road && !IsHouseType(t) && t != tree_row; break;
-		case 13: case 14:
+		case 13:
+			return base && t != path && !IsHouseType(t); break;
+		case 14:
 			return base && t != path; break;
 		case 15: return base; break;
 		default: throw logic_error("Invail LoD number in lod type condition");
@@ -3331,17 +5314,56 @@ namespace osmconverter
 	}
 
 	// Way Generalization
+	void Converter::BuildAreaGrid(short lod, std::vector<Way> &objects)
+	{
+		vector<spatial::Box> boxes = vector<spatial::Box>(objects.size(), spatial::Box());
+
+		// Only areas that may be merged at this LoD are inserted
+		double extent = 0.0;
+		size_t count = 0;
+		for (size_t i = 0; i < objects.size(); i++)
+		{
+			if (objects[i].id != -1 && objects[i].id != -3 && !objects[i].refs.empty() &&
+				objects[i].IsArea() && !objects[i].IsBuilding() && IsLoDType(lod, objects[i].type))
+			{
+				boxes[i] = spatial::Box(objects[i], m_nodes);
+				extent += std::fmax(boxes[i].max_lat - boxes[i].min_lat, boxes[i].max_lon - boxes[i].min_lon);
+				count++;
+			}
+		}
+
+		// Cells are about the size of an average area plus the merge distance
+		double threshold = GetLoDAreaSize(lod) / 2.0;
+		double cell_size = (count > 0 ? extent / (double)count : 0.0) + threshold;
+
+		m_area_grid.Build(boxes, cell_size);
+	}
+
 	void Converter::GeneralizeWays(std::vector<Way> &objects, size_t index, short lod)
 	{
-		// If the Way is the last in the vector or not a polygon return
-		if (index == objects.size() - 1 || !objects[index].IsArea())
+		// If the Way is not a polygon or there is nothing to merge with return
+		if (!objects[index].IsArea() || m_area_grid.Empty())
 			return;
 
-		size_t end = index + 25 < objects.size() ? index + 25 : objects.size() - 1;
-		// Check the 15 following neighbours of the way at 'index'
-		for (size_t i = index + 1; i <= end; i++)
+		double threshold = GetLoDAreaSize(lod) / 2.0;
+		spatial::Box box = spatial::Box(objects[index], m_nodes);
+
+		// Candidates are all areas whose bounding box is within merging distance
+		vector<size_t> candidates = vector<size_t>();
+		m_area_grid.Query(box, threshold, candidates);
+
+		// Try the closest candidates first
+		std::stable_sort(candidates.begin(), candidates.end(), [&](size_t a, size_t b) {
+			return box.Gap(m_area_grid.GetBox(a)) < box.Gap(m_area_grid.GetBox(b));
+		});
+
+		for (size_t c = 0; c < candidates.size(); c++)
 		{
-			//std::cout << "Same Type ? " << (objects[i].type == objects[index].type) << std::endl;
+			size_t i = candidates[c];
+			// Ways before this one were already sorted into tiles
+			if (i <= index)
+				continue;
+
 			// If both Ways have the same type and are areas try to merge them
 			if (objects[i].id != -1 && objects[i].id != -3 && objects[i].type == objects[index].type && objects[i].IsArea())
 			{
@@ -3350,12 +5372,15 @@ namespace osmconverter
 				{
 					// Save new points for the current object
 					objects[index].refs = points;
+					objects[index].Unrank();
 					// Remove duplicates in case polygons shared points
 					objects[index].RemoveDuplicates(&m_nodes);
 					// Invalidate way used for merging
 					objects[i].id = -3;
 
-					//logger.Log(LogLvl::error, "MERGED STUFF");
+					// The merged area now also covers the other way
+					spatial::Box merged = spatial::Box(objects[index], m_nodes);
+					m_area_grid.Insert(index, merged);
 
 					if (objects[index].refs.empty() || (objects[index].refs.size() < 4 && types::IsAreaType(objects[index].type)))
 						logger.Log(LogLvl::error, "Empty or unclosed Way after merging!");
@@ -3375,28 +5400,85 @@ namespace osmconverter
 		}
 	}
 
+	///////////////////////////////////////////////////////
+	// Single Object Clustering
+	///////////////////////////////////////////////////////
+
+	// At the finest LoD every single object is a point of its tile's point array,
+	// at coarser LoDs all objects of one type in a cluster cell are replaced by their
+	// centroid, weighted by the number of objects it stands for
+	void Converter::SortSingles(short lod)
+	{
+		// Accumulated coordinates and count per tile, cell and type
+		struct Cluster
+		{
+			double lat, lon;
+			unsigned int count;
+		};
+		std::map<std::tuple<size_t, size_t, int>, Cluster> clusters = std::map<std::tuple<size_t, size_t, int>, Cluster>();
+
+		for (size_t t = 0; t < m_singles.size(); t++)
+		{
+			size_t tile_index = FindTile(m_singles[t].index, node);
+			// If not all tiles are in the tile vector and the tile of interest
+			// could not be found an overflow occured and the next steps are skipped
+			if (GetOverflow())
+				continue;
+
+			if (!m_singles[t].IsInsideTile(m_tiles[tile_index], m_nodes))
+				logger.Log(LogLvl::error, 1, "Computed tile does not match single object data");
+
+			Node &point = m_nodes[m_singles[t].index];
+			Tile &tile = m_tiles[tile_index];
+
+			if (lod == C_MAX_LOD)
+			{
+				tile.AddPoint(m_singles[t].type, point.lat, point.lon, 1);
+				continue;
+			}
+
+			double cell_lat = (tile.max_lat - tile.min_lat) / C_CLUSTER_CELLS;
+			double cell_lon = (tile.max_lon - tile.min_lon) / C_CLUSTER_CELLS;
+
+			size_t row = cell_lat > 0.0 ? std::min((size_t)std::max((point.lat - tile.min_lat) / cell_lat, 0.0), C_CLUSTER_CELLS - 1) : 0;
+			size_t col = cell_lon > 0.0 ? std::min((size_t)std::max((point.lon - tile.min_lon) / cell_lon, 0.0), C_CLUSTER_CELLS - 1) : 0;
+
+			Cluster &cluster = clusters[std::make_tuple(tile_index, col + row * C_CLUSTER_CELLS, (int)m_singles[t].type)];
+			cluster.lat += point.lat;
+			cluster.lon += point.lon;
+			cluster.count++;
+		}
+
+		for (auto &entry : clusters)
+		{
+			Cluster &cluster = entry.second;
+			m_tiles[std::get<0>(entry.first)].AddPoint((Type)std::get<2>(entry.first), cluster.lat / cluster.count, cluster.lon / cluster.count, cluster.count);
+		}
+
+		if (lod != C_MAX_LOD)
+			logger.Log(LogLvl::info, "Clustered " + std::to_string(m_singles.size()) + " single objects into " + std::to_string(clusters.size()) + " points");
+	}
+
 	void Converter::SortWays(short lod, vector<Way> &objects)
 	{
 		size_t tile_index = 0;
 
 		logger.Log(LogLvl::info, "Sorting Ways for Tile " + std::to_string(lod));
 
-		if (lod == C_MAX_LOD)
-		{
-			for (size_t t = 0; t < m_singles.size(); t++)
-			{
-				tile_index = FindTile(m_singles[t].index, node);
-				// If not all tiles are in the tile vector and the tile of interest
-				// could not be found an overflow occured and the next steps are skipped
-				if (GetOverflow())
-					continue;
+		if (lod >= C_CLUSTER_MIN_LOD)
+			SortSingles(lod);
 
-				if (!m_singles[t].IsInsideTile(m_tiles[tile_index], m_nodes))
-					logger.Log(LogLvl::error, 1, "Computed tile does not match single object data");
+		// Join lines that continue each other so they are simplified as a whole
+		if (lod <= C_MERGE_LINE_LOD)
+			MergeLines(lod, objects);
 
-				m_tiles[tile_index].solo_refs.push_back(t);
-			}
-		}
+		// Dissolve clusters of same-type areas before looking for merging partners
+		if (lod <= C_DISSOLVE_LOD)
+			DissolveAreas(lod, objects);
+
+		// Merging candidates are looked up by location
+		if (lod != C_MAX_LOD)
+			BuildAreaGrid(lod, objects);
 
 		// Reset tile index values
 		tile_index = 0;
@@ -3414,27 +5496,22 @@ namespace osmconverter
 					// If object is an Area and below a certain Area size try to merge it
 					// with neighbouring objects of the same type
 					double area_threshold = GetLoDAreaSize(lod);
-					if (lod != C_MAX_LOD && !objects[i].IsHouse() && objects[i].IsArea() && objects[i].Area(m_nodes) < area_threshold)
+					if (lod != C_MAX_LOD && !objects[i].IsBuilding() && objects[i].IsArea() && objects[i].Area(m_nodes) < area_threshold)
 						GeneralizeWays(objects, i, lod);
 					// Only include this object if it is big enough measued by Area size
-					if (lod == C_MAX_LOD || !objects[i].IsArea() || objects[i].IsHouse() ||(objects[i].IsArea() && objects[i].Area(m_nodes) >= area_threshold))
+					if (lod == C_MAX_LOD || !objects[i].IsArea() || objects[i].IsBuilding() ||(objects[i].IsArea() && objects[i].Area(m_nodes) >= area_threshold))
 					{
-						if (lod != C_MAX_LOD && objects[i].refs.size() > 4)
-						{
-							bool restore = false;
-							if (objects[i].IsArea() || objects[i].IsCircularWay())
-							{
-								objects[i].refs.pop_back();
-								restore = true;
-							}
+						if (lod != C_MAX_LOD && objects[i].refs.size() > 4 && m_borders.find(i) == m_borders.end())
+							SimplifyWay(lod, objects[i]);
 
-							if (m_line)
-								objects[i].refs = DouglasPeucker(objects[i].refs, GetLoDEpsilon(lod));
-							else
-								objects[i].refs = VisvalingamWhyatt(objects[i].refs, GetLoDPercentage(lod, objects[i].refs.size()));
+						// Ways spanning many tiles are referenced by all of them instead
+						if (m_share > 0 && ShareWay(i))
+							continue;
 
-							if (restore)
-								objects[i].refs.push_back(objects[i].refs[0]);
+						if (m_sort == clip)
+						{
+							ClipToTiles(i);
+							continue;
 						}
 
 						tile_index = FindTile(i, way);
@@ -3465,13 +5542,15 @@ namespace osmconverter
 
 						m_tiles[tile_index].way_refs.push_back(i);
 					}
-					else if (lod != C_MAX_LOD && objects[i].IsArea() && !objects[i].IsHouse())
+					else if (lod != C_MAX_LOD && objects[i].IsArea() && !objects[i].IsBuilding())
 					{
 						//std::cout << "Objekt = " << objects[i].Area(m_nodes) << ", Grenze = " << area_threshold << std::endl;
 					}
 				}
 			}
 		}
+
+		m_area_grid.Clear();
 	}
 
 	// Relation Generalization
@@ -3540,27 +5619,14 @@ namespace osmconverter
 						{
 							// We only need to simplify ways because nodes can't be simplified
 							// and member relations will automatically generalized in this function
-							if (objects[i].member_types[o] == way)
-							{
-								size_t save = 0;
-								bool restore = false;
-								if (m_ways[objects[i].refs[o]].IsArea() || m_ways[objects[i].refs[o]].IsCircularWay())
-								{
-									m_ways[objects[i].refs[o]].refs.pop_back();
-									restore = true;
-								}
-
-								if (m_line)
-									m_ways[objects[i].refs[o]].refs = DouglasPeucker(m_ways[objects[i].refs[o]].refs, GetLoDEpsilon(lod));
-								else
-									m_ways[objects[i].refs[o]].refs = VisvalingamWhyatt(m_ways[objects[i].refs[o]].refs, GetLoDPercentage(lod, m_ways[objects[i].refs[o]].refs.size()));
-
-								if (restore)
-									m_ways[objects[i].refs[o]].refs.push_back(m_ways[objects[i].refs[o]].refs[0]);
-							}
+							if (objects[i].member_types[o] == way && m_borders.find(objects[i].refs[o]) == m_borders.end())
+								SimplifyWay(lod, m_ways[objects[i].refs[o]]);
 						}
 					}
 
+					if (m_share > 0 && ShareRelation(i))
+						continue;
+
 					tile_index = FindTile(i, relation);
 					// If not all tiles are in the tile vector and the tile of interest
 					// could not be found an overflow occured and the next steps are skipped
@@ -0,0 +1,164 @@
+#include "..\\header\\kernels.h"
+
+#include <cmath>
+
+#ifdef KERNELS_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace kernels
+{
+	// Runtime detection
+	static Level Detect()
+	{
+#ifdef KERNELS_AVX2
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return scalar;
+
+		// The OS has to save the ymm registers (OSXSAVE and AVX, then XCR0 bits 1 and 2)
+		__cpuid(info, 1);
+		if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6)
+			return scalar;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0 ? avx2 : scalar;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") ? avx2 : scalar;
+#endif
+#else
+		return scalar;
+#endif
+	}
+
+	Level GetLevel()
+	{
+		static const Level level = Detect();
+		return level;
+	}
+
+	void SegmentDistances(const double *x, const double *y, size_t count, double sx, double sy, double ex, double ey, double *result)
+	{
+#ifdef KERNELS_AVX2
+		if (GetLevel() == avx2)
+		{
+			SegmentDistancesAVX2(x, y, count, sx, sy, ex, ey, result);
+			return;
+		}
+#endif
+		SegmentDistancesScalar(x, y, count, sx, sy, ex, ey, result);
+	}
+
+	void TriangleAreas(const double *x, const double *y, size_t count, double *result)
+	{
+#ifdef KERNELS_AVX2
+		if (GetLevel() == avx2)
+		{
+			TriangleAreasAVX2(x, y, count, result);
+			return;
+		}
+#endif
+		TriangleAreasScalar(x, y, count, result);
+	}
+
+	// Scalar
+	void SegmentDistancesScalar(const double *x, const double *y, size_t count, double sx, double sy, double ex, double ey, double *result)
+	{
+		double dx = ex - sx;
+		double dy = ey - sy;
+
+		if (dx == 0.0 && dy == 0.0)
+		{
+			for (size_t i = 0; i < count; i++)
+				result[i] = std::sqrt((x[i] - sx) * (x[i] - sx) + (y[i] - sy) * (y[i] - sy));
+
+			return;
+		}
+
+		// |cross(end - start, point - start)| / |end - start|
+		double inverse = 1.0 / std::sqrt(dx * dx + dy * dy);
+		for (size_t i = 0; i < count; i++)
+			result[i] = std::fabs(dx * (y[i] - sy) - dy * (x[i] - sx)) * inverse;
+	}
+
+	void TriangleAreasScalar(const double *x, const double *y, size_t count, double *result)
+	{
+		for (size_t i = 0; i + 2 < count; i++)
+			result[i] = std::fabs((x[i + 1] - x[i]) * (y[i + 2] - y[i]) - (y[i + 1] - y[i]) * (x[i + 2] - x[i])) * 0.5;
+	}
+
+#ifdef KERNELS_AVX2
+	// AVX2, four points per iteration
+	KERNELS_TARGET_AVX2
+	static inline __m256d Abs(__m256d v)
+	{
+		return _mm256_andnot_pd(_mm256_set1_pd(-0.0), v);
+	}
+
+	KERNELS_TARGET_AVX2
+	void SegmentDistancesAVX2(const double *x, const double *y, size_t count, double sx, double sy, double ex, double ey, double *result)
+	{
+		double dx = ex - sx;
+		double dy = ey - sy;
+		size_t i = 0;
+
+		const __m256d start_x = _mm256_set1_pd(sx);
+		const __m256d start_y = _mm256_set1_pd(sy);
+
+		if (dx == 0.0 && dy == 0.0)
+		{
+			for (; i + 4 <= count; i += 4)
+			{
+				__m256d px = _mm256_sub_pd(_mm256_loadu_pd(x + i), start_x);
+				__m256d py = _mm256_sub_pd(_mm256_loadu_pd(y + i), start_y);
+				_mm256_storeu_pd(result + i, _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(px, px), _mm256_mul_pd(py, py))));
+			}
+		}
+		else
+		{
+			const __m256d dir_x = _mm256_set1_pd(dx);
+			const __m256d dir_y = _mm256_set1_pd(dy);
+			const __m256d inverse = _mm256_set1_pd(1.0 / std::sqrt(dx * dx + dy * dy));
+
+			for (; i + 4 <= count; i += 4)
+			{
+				__m256d px = _mm256_sub_pd(_mm256_loadu_pd(x + i), start_x);
+				__m256d py = _mm256_sub_pd(_mm256_loadu_pd(y + i), start_y);
+				__m256d cross = _mm256_sub_pd(_mm256_mul_pd(dir_x, py), _mm256_mul_pd(dir_y, px));
+				_mm256_storeu_pd(result + i, _mm256_mul_pd(Abs(cross), inverse));
+			}
+		}
+
+		SegmentDistancesScalar(x + i, y + i, count - i, sx, sy, ex, ey, result + i);
+	}
+
+	KERNELS_TARGET_AVX2
+	void TriangleAreasAVX2(const double *x, const double *y, size_t count, double *result)
+	{
+		size_t i = 0;
+		const __m256d half = _mm256_set1_pd(0.5);
+
+		for (; i + 6 <= count; i += 4)
+		{
+			__m256d ax = _mm256_loadu_pd(x + i);
+			__m256d ay = _mm256_loadu_pd(y + i);
+			__m256d bx = _mm256_sub_pd(_mm256_loadu_pd(x + i + 1), ax);
+			__m256d by = _mm256_sub_pd(_mm256_loadu_pd(y + i + 1), ay);
+			__m256d cx = _mm256_sub_pd(_mm256_loadu_pd(x + i + 2), ax);
+			__m256d cy = _mm256_sub_pd(_mm256_loadu_pd(y + i + 2), ay);
+
+			__m256d cross = _mm256_sub_pd(_mm256_mul_pd(bx, cy), _mm256_mul_pd(by, cx));
+			_mm256_storeu_pd(result + i, _mm256_mul_pd(Abs(cross), half));
+		}
+
+		if (i + 2 < count)
+			TriangleAreasScalar(x + i, y + i, count - i, result + i);
+	}
+#endif
+}
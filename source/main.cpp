@@ -27,15 +27,27 @@ int main() {
 	bool line;
 	// Root number of Tiles per LoD
 	size_t lods[16] = { 0 };
+	// Line simplification algorithm per LoD
+	types::Simplification simplify[16];
+	// Minimum number of tiles an object has to span to be stored in the shared section
+	size_t share;
+	// Raster cells per tile side for landcover generalization at the coarsest LoDs
+	size_t raster;
+	// Number of coarsest LoDs that show small areas as their convex hull
+	size_t hull;
+	// zlib level per LoD used to compress its tiles, 0 stores them raw
+	int compress[16] = { 0 };
+	// Key the objects of a tile are ordered by
+	types::Importance importance;
 
 	// Set background coloer to black and text color to white (usually the default anyway)
 	ResetConsoleColor();
 	// Create new parser/converter
 	osmconverter::Converter parser = osmconverter::Converter();
 	// Get user input from command line
-	GetUserInput(in, out, debug, line, loglevel, lods, sort);
+	GetUserInput(in, out, debug, line, loglevel, lods, sort, simplify, share, raster, hull, compress, importance);
 	// Set converter parameters according to user input
-	parser.SetParameters(in, out, debug, line, loglevel, lods, sort);
+	parser.SetParameters(in, out, debug, line, loglevel, lods, sort, simplify, share, raster, hull, compress, importance);
 
 	// Time before conversion
 	std::chrono::time_point<std::chrono::system_clock> before = std::chrono::system_clock::now();
@@ -44,7 +44,118 @@ bool mathtools::operator>=(const triangle & lhs, const triangle & rhs)
 
 double mathtools::triangle::Area(vec2 a, vec2 b, vec2 c)
 {
-	return 1 / 2 * c.PerpendicularDistance(a, b) * a.Distance(b);
+	return fabs(vec2::Orientation(a, b, c)) / 2.0;
+}
+
+// TriangleHeap Implementations
+mathtools::TriangleHeap::TriangleHeap()
+{
+	m_heap = std::vector<triangle>();
+	m_position = std::vector<size_t>();
+}
+
+mathtools::TriangleHeap::TriangleHeap(size_t count)
+{
+	m_heap = std::vector<triangle>();
+	m_heap.reserve(count);
+	m_position = std::vector<size_t>(count, std::numeric_limits<size_t>::max());
+}
+
+bool mathtools::TriangleHeap::Empty()
+{
+	return m_heap.empty();
+}
+
+size_t mathtools::TriangleHeap::Size()
+{
+	return m_heap.size();
+}
+
+bool mathtools::TriangleHeap::Contains(size_t index)
+{
+	return index < m_position.size() && m_position[index] != std::numeric_limits<size_t>::max();
+}
+
+void mathtools::TriangleHeap::Push(triangle t)
+{
+	if (t.index >= m_position.size())
+		m_position.resize(t.index + 1, std::numeric_limits<size_t>::max());
+
+	m_heap.push_back(t);
+	m_position[t.index] = m_heap.size() - 1;
+	SiftUp(m_heap.size() - 1);
+}
+
+mathtools::triangle mathtools::TriangleHeap::Pop()
+{
+	if (m_heap.empty())
+		throw length_error("Tried to pop from an empty triangle heap");
+
+	triangle top = m_heap[0];
+
+	Swap(0, m_heap.size() - 1);
+	m_heap.pop_back();
+	m_position[top.index] = std::numeric_limits<size_t>::max();
+
+	if (!m_heap.empty())
+		SiftDown(0);
+
+	return top;
+}
+
+void mathtools::TriangleHeap::Update(size_t index, double area)
+{
+	if (!Contains(index))
+		return;
+
+	size_t pos = m_position[index];
+	double before = m_heap[pos].area;
+	m_heap[pos].area = area;
+
+	if (area < before)
+		SiftUp(pos);
+	else
+		SiftDown(pos);
+}
+
+void mathtools::TriangleHeap::SiftUp(size_t pos)
+{
+	while (pos > 0)
+	{
+		size_t parent = (pos - 1) / 2;
+		if (m_heap[parent] <= m_heap[pos])
+			break;
+
+		Swap(parent, pos);
+		pos = parent;
+	}
+}
+
+void mathtools::TriangleHeap::SiftDown(size_t pos)
+{
+	size_t size = m_heap.size();
+	while (true)
+	{
+		size_t left = 2 * pos + 1, right = 2 * pos + 2, smallest = pos;
+
+		if (left < size && m_heap[left] < m_heap[smallest])
+			smallest = left;
+		if (right < size && m_heap[right] < m_heap[smallest])
+			smallest = right;
+
+		if (smallest == pos)
+			break;
+
+		Swap(smallest, pos);
+		pos = smallest;
+	}
+}
+
+void mathtools::TriangleHeap::Swap(size_t a, size_t b)
+{
+	std::swap(m_heap[a], m_heap[b]);
+	m_position[m_heap[a].index] = a;
+	m_position[m_heap[b].index] = b;
 }
 
 // Vec2 Implementations
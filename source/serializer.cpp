@@ -0,0 +1,359 @@
+#include "..\\header\\serializer.h"
+
+#include <cstring>
+#include <cmath>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace serializer
+{
+	Buffer::Buffer()
+	{
+		m_data = std::vector<char>(1 << 16);
+		m_size = 0;
+
+		SetFrame(0.0, 0.0, 1.0, 1.0);
+	}
+
+	Buffer::Buffer(size_t capacity)
+	{
+		m_data = std::vector<char>(capacity > 0 ? capacity : 1);
+		m_size = 0;
+
+		SetFrame(0.0, 0.0, 1.0, 1.0);
+	}
+
+	void Buffer::Put(const void *data, size_t bytes)
+	{
+		if (bytes == 0)
+			return;
+
+		Reserve(bytes);
+		std::memcpy(m_data.data() + m_size, data, bytes);
+		m_size += bytes;
+	}
+
+	void Buffer::PutVarint(unsigned long long value)
+	{
+		unsigned char bytes[10];
+		size_t count = 0;
+
+		while (value >= 0x80)
+		{
+			bytes[count++] = (unsigned char)(value | 0x80);
+			value >>= 7;
+		}
+		bytes[count++] = (unsigned char)value;
+
+		Put(bytes, count);
+	}
+
+	void Buffer::PutSigned(long long value)
+	{
+		PutVarint(ZigZag(value));
+	}
+
+	void Buffer::SetFrame(double origin_lat, double origin_lon, double step_lat, double step_lon)
+	{
+		m_origin_lat = origin_lat;
+		m_origin_lon = origin_lon;
+		m_step_lat = step_lat;
+		m_step_lon = step_lon;
+
+		BeginPoints();
+	}
+
+	void Buffer::BeginPoints()
+	{
+		m_prev_lat = 0;
+		m_prev_lon = 0;
+	}
+
+	// Points are quantized before the delta is taken, so rounding errors do not add up along a line
+	void Buffer::PutPoint(double lat, double lon)
+	{
+		long long q_lat = std::llround((lat - m_origin_lat) / m_step_lat);
+		long long q_lon = std::llround((lon - m_origin_lon) / m_step_lon);
+
+		PutSigned(q_lat - m_prev_lat);
+		PutSigned(q_lon - m_prev_lon);
+
+		m_prev_lat = q_lat;
+		m_prev_lon = q_lon;
+	}
+
+	bool Buffer::ReadAt(FILE *in, long long offset, size_t bytes)
+	{
+		if (bytes == 0)
+			return true;
+
+		Reserve(bytes);
+		if (!serializer::ReadAt(in, offset, m_data.data() + m_size, bytes))
+			return false;
+
+		m_size += bytes;
+		return true;
+	}
+
+	char* Buffer::Extend(size_t bytes)
+	{
+		Reserve(bytes);
+		m_size += bytes;
+
+		return m_data.data() + m_size - bytes;
+	}
+
+	void Buffer::Truncate(size_t size)
+	{
+		if (size < m_size)
+			m_size = size;
+	}
+
+	void Buffer::Clear()
+	{
+		m_size = 0;
+	}
+
+	size_t Buffer::Size()
+	{
+		return m_size;
+	}
+
+	const char* Buffer::Data()
+	{
+		return m_data.data();
+	}
+
+	unsigned long long Buffer::Hash()
+	{
+		unsigned long long hash = 14695981039346656037ULL;
+		for (size_t i = 0; i < m_size; i++)
+		{
+			hash ^= (unsigned char)m_data[i];
+			hash *= 1099511628211ULL;
+		}
+
+		return hash;
+	}
+
+	bool Buffer::Flush(FILE *out)
+	{
+		size_t written = m_size > 0 ? fwrite(m_data.data(), 1, m_size, out) : 0;
+		bool complete = written == m_size;
+		m_size = 0;
+
+		return complete;
+	}
+
+	bool Buffer::FlushAt(FILE *out, long long offset)
+	{
+		bool complete = serializer::WriteAt(out, offset, m_data.data(), m_size);
+		m_size = 0;
+
+		return complete;
+	}
+
+	// Grows geometrically so encoding a tile only reallocates a few times
+	void Buffer::Reserve(size_t bytes)
+	{
+		if (m_size + bytes <= m_data.size())
+			return;
+
+		size_t capacity = m_data.size();
+		while (capacity < m_size + bytes)
+			capacity *= 2;
+
+		m_data.resize(capacity);
+	}
+
+	///////////////////////////////////////////////////////
+	// Reader
+	///////////////////////////////////////////////////////
+	Reader::Reader()
+	{
+		m_file = NULL;
+		m_at = m_end = 0;
+		m_pos = m_size = 0;
+	}
+
+	Reader::Reader(FILE *in, long long begin, long long end)
+	{
+		m_file = in;
+		m_at = begin;
+		m_end = end;
+		m_data = std::vector<char>(1 << 16);
+		m_pos = m_size = 0;
+	}
+
+	bool Reader::GetVarint(unsigned long long &value)
+	{
+		// A varint takes at most 10 bytes
+		if (m_size - m_pos < 10 && m_at < m_end && !Fill())
+			return false;
+
+		value = 0;
+		for (int shift = 0; m_pos < m_size && shift < 64; shift += 7)
+		{
+			unsigned char byte = (unsigned char)m_data[m_pos++];
+			value |= (unsigned long long)(byte & 0x7F) << shift;
+
+			if ((byte & 0x80) == 0)
+				return true;
+		}
+
+		return false;
+	}
+
+	void Reader::Skip(long long bytes)
+	{
+		if (bytes <= (long long)(m_size - m_pos))
+		{
+			m_pos += (size_t)bytes;
+			return;
+		}
+
+		m_at = Position() + bytes;
+		m_pos = m_size = 0;
+	}
+
+	long long Reader::Position()
+	{
+		return m_at - (long long)(m_size - m_pos);
+	}
+
+	bool Reader::End()
+	{
+		return Position() >= m_end;
+	}
+
+	// Keeps the bytes not read yet and appends the next chunk of the region
+	bool Reader::Fill()
+	{
+		size_t left = m_size - m_pos;
+		std::memmove(m_data.data(), m_data.data() + m_pos, left);
+		m_pos = 0;
+		m_size = left;
+
+		long long bytes = (long long)(m_data.size() - m_size);
+		bytes = m_end - m_at < bytes ? m_end - m_at : bytes;
+		if (bytes <= 0)
+			return true;
+
+		if (!ReadAt(m_file, m_at, m_data.data() + m_size, (size_t)bytes))
+			return false;
+
+		m_at += bytes;
+		m_size += (size_t)bytes;
+		return true;
+	}
+
+	///////////////////////////////////////////////////////
+	// Positional File Access
+	///////////////////////////////////////////////////////
+#ifdef _WIN32
+	// ReadFile and WriteFile with an offset move the file pointer of a synchronous handle behind the
+	// back of the buffered stream, so they must not be mixed with stdio access to the same file
+	bool ReadAt(FILE *in, long long offset, void *data, size_t bytes)
+	{
+		HANDLE handle = (HANDLE)_get_osfhandle(_fileno(in));
+		char *at = (char*)data;
+
+		while (bytes > 0)
+		{
+			DWORD chunk = bytes > 0x40000000 ? 0x40000000 : (DWORD)bytes;
+			DWORD read = 0;
+
+			OVERLAPPED position = OVERLAPPED();
+			position.Offset = (DWORD)(offset & 0xFFFFFFFF);
+			position.OffsetHigh = (DWORD)(offset >> 32);
+
+			if (!ReadFile(handle, at, chunk, &read, &position) || read == 0)
+				return false;
+
+			at += read;
+			offset += read;
+			bytes -= read;
+		}
+
+		return true;
+	}
+
+	bool WriteAt(FILE *out, long long offset, const void *data, size_t bytes)
+	{
+		HANDLE handle = (HANDLE)_get_osfhandle(_fileno(out));
+		const char *at = (const char*)data;
+
+		while (bytes > 0)
+		{
+			DWORD chunk = bytes > 0x40000000 ? 0x40000000 : (DWORD)bytes;
+			DWORD written = 0;
+
+			OVERLAPPED position = OVERLAPPED();
+			position.Offset = (DWORD)(offset & 0xFFFFFFFF);
+			position.OffsetHigh = (DWORD)(offset >> 32);
+
+			if (!WriteFile(handle, at, chunk, &written, &position) || written == 0)
+				return false;
+
+			at += written;
+			offset += written;
+			bytes -= written;
+		}
+
+		return true;
+	}
+
+	bool Preallocate(FILE *out, long long size)
+	{
+		fflush(out);
+		return _chsize_s(_fileno(out), size) == 0;
+	}
+#else
+	bool ReadAt(FILE *in, long long offset, void *data, size_t bytes)
+	{
+		char *at = (char*)data;
+
+		while (bytes > 0)
+		{
+			ssize_t read = pread(fileno(in), at, bytes, (off_t)offset);
+			if (read <= 0)
+				return false;
+
+			at += read;
+			offset += read;
+			bytes -= (size_t)read;
+		}
+
+		return true;
+	}
+
+	bool WriteAt(FILE *out, long long offset, const void *data, size_t bytes)
+	{
+		const char *at = (const char*)data;
+
+		while (bytes > 0)
+		{
+			ssize_t written = pwrite(fileno(out), at, bytes, (off_t)offset);
+			if (written <= 0)
+				return false;
+
+			at += written;
+			offset += written;
+			bytes -= (size_t)written;
+		}
+
+		return true;
+	}
+
+	bool Preallocate(FILE *out, long long size)
+	{
+		fflush(out);
+		return ftruncate(fileno(out), (off_t)size) == 0;
+	}
+#endif
+}
@@ -0,0 +1,282 @@
+#include "..\\header\\simplification.h"
+#include "..\\header\\kernels.h"
+
+using mathtools::triangle;
+using mathtools::vec2;
+
+namespace simplification
+{
+	// Distance of a point to the line through start and end,
+	// degenerated lines (e.g. of closed rings) use the distance to the start point
+	static double LineDistance(types::Node &start, types::Node &end, types::Node &at)
+	{
+		vec2 first = vec2(start);
+		vec2 last = vec2(end);
+		vec2 point = vec2(at);
+
+		if (first == last)
+			return point.Distance(first);
+
+		return point.PerpendicularDistance(first, last);
+	}
+
+	// Copies the coordinates of a line into separate arrays for the batch kernels
+	static void Coordinates(vector<size_t> &line, vector<types::Node> &nodes, vector<double> &x, vector<double> &y)
+	{
+		x.resize(line.size());
+		y.resize(line.size());
+		for (size_t i = 0; i < line.size(); i++)
+		{
+			x[i] = nodes[line[i]].lon;
+			y[i] = nodes[line[i]].lat;
+		}
+	}
+
+	// Douglas-Peucker
+	void DouglasPeucker::Importance(vector<size_t> &line, vector<types::Node> &nodes, vector<double> &importance)
+	{
+		// Part of the line that still needs to be split
+		struct range {
+			size_t first, last;
+			// Importance of the vertex that split this range
+			double cap;
+		};
+
+		// First and last point are never removed
+		importance.assign(line.size(), std::numeric_limits<double>::max());
+
+		if (line.size() < 3)
+			return;
+
+		vector<double> x = vector<double>(), y = vector<double>();
+		Coordinates(line, nodes, x, y);
+		vector<double> distances = vector<double>(line.size(), 0.0);
+
+		vector<range> ranges = vector<range>();
+		ranges.push_back(range{ 0, line.size() - 1, std::numeric_limits<double>::max() });
+
+		while (!ranges.empty())
+		{
+			range current = ranges.back();
+			ranges.pop_back();
+
+			if (current.last - current.first < 2)
+				continue;
+
+			// Find point of furthest Distance from the line between first and last point
+			kernels::SegmentDistances(x.data() + current.first + 1, y.data() + current.first + 1, current.last - current.first - 1,
+				x[current.first], y[current.first], x[current.last], y[current.last], distances.data() + current.first + 1);
+
+			size_t index = current.first + 1;
+			double max = -1.0;
+			for (size_t i = current.first + 1; i < current.last; i++)
+			{
+				if (distances[i] > max)
+				{
+					index = i;
+					max = distances[i];
+				}
+			}
+
+			// A vertex never outlives the vertex that split its range, so all LoDs stay nested
+			double value = max < current.cap ? max : current.cap;
+			importance[index] = value;
+
+			ranges.push_back(range{ current.first, index, value });
+			ranges.push_back(range{ index, current.last, value });
+		}
+	}
+
+	void DouglasPeucker::Simplify(types::Way &way, vector<types::Node> &nodes, double epsilon, size_t /*keep*/)
+	{
+		// Ways whose references changed since the last ranking are ranked again
+		if (!way.IsRanked() || way.ranking != type)
+			RankWay<DouglasPeucker>(way, nodes);
+
+		// Account for precision loss using epsilon range around epsilon
+		way.Filter(epsilon - types::DOUBLE_EPSILON);
+	}
+
+	// Visvalingam-Whyatt
+	void VisvalingamWhyatt::Importance(vector<size_t> &line, vector<types::Node> &nodes, vector<double> &areas)
+	{
+		size_t size = line.size();
+		// First and last point can never be removed
+		areas.assign(size, std::numeric_limits<double>::max());
+
+		if (size < 3)
+			return;
+
+		// Doubly linked list of the points that are still part of the line
+		vector<size_t> prev = vector<size_t>(size), next = vector<size_t>(size);
+		for (size_t i = 0; i < size; i++)
+		{
+			prev[i] = i - 1;
+			next[i] = i + 1;
+		}
+
+		// Initial areas of all triangles in one batch
+		vector<double> x = vector<double>(), y = vector<double>();
+		Coordinates(line, nodes, x, y);
+		vector<double> initial = vector<double>(size - 2);
+		kernels::TriangleAreas(x.data(), y.data(), size, initial.data());
+
+		mathtools::TriangleHeap heap = mathtools::TriangleHeap(size);
+		for (size_t i = 1; i < size - 1; i++)
+		{
+			heap.Push(triangle(i, initial[i - 1]));
+		}
+
+		double last = 0.0;
+		while (!heap.Empty())
+		{
+			triangle current = heap.Pop();
+
+			// A point's effective area is never smaller than that of a point removed before it
+			last = current.area > last ? current.area : last;
+			areas[current.index] = last;
+
+			size_t before = prev[current.index], after = next[current.index];
+			next[before] = after;
+			prev[after] = before;
+
+			// Only the two neighbours' triangles change
+			if (before > 0)
+				heap.Update(before, triangle::Area(vec2(nodes[line[prev[before]]]), vec2(nodes[line[before]]), vec2(nodes[line[after]])));
+			if (after < size - 1)
+				heap.Update(after, triangle::Area(vec2(nodes[line[before]]), vec2(nodes[line[after]]), vec2(nodes[line[next[after]]])));
+		}
+	}
+
+	void VisvalingamWhyatt::Simplify(types::Way &way, vector<types::Node> &nodes, double /*epsilon*/, size_t keep)
+	{
+		// Ways whose references changed since the last ranking are ranked again
+		if (!way.IsRanked() || way.ranking != type)
+			RankWay<VisvalingamWhyatt>(way, nodes);
+
+		way.FilterCount(keep);
+	}
+
+	// Radial Distance
+	void RadialDistance::Line(vector<size_t> &line, vector<types::Node> &nodes, double epsilon, vector<size_t> &result)
+	{
+		if (line.empty())
+			return;
+
+		// Keep a point once it is further away from the last kept point than epsilon
+		result.push_back(line[0]);
+		for (size_t i = 1; i + 1 < line.size(); i++)
+		{
+			if (nodes[line[i]].Distance(nodes[result.back()]) > epsilon)
+				result.push_back(line[i]);
+		}
+
+		if (line.size() > 1)
+			result.push_back(line.back());
+	}
+
+	void RadialDistance::Simplify(types::Way &way, vector<types::Node> &nodes, double epsilon, size_t /*keep*/)
+	{
+		SimplifyLine<RadialDistance>(way, nodes, epsilon);
+	}
+
+	// Reumann-Witkam
+	void ReumannWitkam::Line(vector<size_t> &line, vector<types::Node> &nodes, double epsilon, vector<size_t> &result)
+	{
+		if (line.empty())
+			return;
+
+		// The strip is given by the last key point and its successor, the point before
+		// the first one leaving the strip becomes the next key point
+		size_t key = 0;
+		result.push_back(line[0]);
+		for (size_t i = 2; i < line.size(); i++)
+		{
+			if (LineDistance(nodes[line[key]], nodes[line[key + 1]], nodes[line[i]]) > epsilon)
+			{
+				key = i - 1;
+				result.push_back(line[key]);
+			}
+		}
+
+		if (line.size() > 1)
+			result.push_back(line.back());
+	}
+
+	void ReumannWitkam::Simplify(types::Way &way, vector<types::Node> &nodes, double epsilon, size_t /*keep*/)
+	{
+		SimplifyLine<ReumannWitkam>(way, nodes, epsilon);
+	}
+
+	// Grid Snap
+	void GridSnap::Line(vector<size_t> &line, vector<types::Node> &nodes, double epsilon, vector<pair<long long, long long>> &cells)
+	{
+		if (line.size() < 3)
+			return;
+
+		// Consecutive points inside the same grid cell are replaced by one point at the cell center,
+		// the end points stay in place so connected ways and shared border chains still meet
+		long long row = (long long)std::floor(nodes[line[0]].lat / epsilon);
+		long long col = (long long)std::floor(nodes[line[0]].lon / epsilon);
+		long long last_row = (long long)std::floor(nodes[line.back()].lat / epsilon);
+		long long last_col = (long long)std::floor(nodes[line.back()].lon / epsilon);
+
+		for (size_t i = 1; i + 1 < line.size(); i++)
+		{
+			long long r = (long long)std::floor(nodes[line[i]].lat / epsilon);
+			long long c = (long long)std::floor(nodes[line[i]].lon / epsilon);
+
+			// The cells of the end points are already represented by them
+			if ((r == row && c == col) || (r == last_row && c == last_col))
+				continue;
+
+			row = r;
+			col = c;
+			cells.push_back(std::make_pair(r, c));
+		}
+	}
+
+	void GridSnap::Simplify(types::Way &way, vector<types::Node> &nodes, double epsilon, unordered_map<long long, size_t> &snapped)
+	{
+		bool closed = way.refs.size() > 1 && way.IsCircularWay();
+		vector<size_t> line = vector<size_t>(way.refs.begin(), closed ? way.refs.end() - 1 : way.refs.end());
+
+		if (line.empty())
+			return;
+
+		vector<pair<long long, long long>> cells = vector<pair<long long, long long>>();
+		Line(line, nodes, epsilon, cells);
+
+		// Rings need at least three distinct points, otherwise the way stays as it is
+		size_t ends = line.size() > 1 ? 2 : 1;
+		if (closed && cells.size() + ends < 3)
+			return;
+
+		vector<size_t> result = vector<size_t>();
+		result.reserve(cells.size() + ends + 1);
+		result.push_back(line[0]);
+
+		// Snapped points are new nodes since the original ones may be used by other ways,
+		// ways snapped to the same cell share its node
+		for (size_t i = 0; i < cells.size(); i++)
+		{
+			long long key = cells[i].first * 4294967296LL + (cells[i].second & 0xFFFFFFFFLL);
+			auto it = snapped.find(key);
+			if (it == snapped.end())
+			{
+				nodes.push_back(types::Node(((double)cells[i].first + 0.5) * epsilon, ((double)cells[i].second + 0.5) * epsilon, -2));
+				it = snapped.insert(std::make_pair(key, nodes.size() - 1)).first;
+			}
+			result.push_back(it->second);
+		}
+
+		if (line.size() > 1)
+			result.push_back(line.back());
+
+		if (closed)
+			result.push_back(result[0]);
+
+		way.refs = result;
+		way.Unrank();
+	}
+}
@@ -0,0 +1,215 @@
+#include "..\\header\\spatial.h"
+
+#include <cmath>
+
+// Maximum number of cells along each axis
+#define MAX_GRID_DIM 1024
+
+namespace spatial
+{
+	// Box functions
+	Box::Box()
+	{
+		// Inverted box, extending it with any other box yields that box
+		min_lat = std::numeric_limits<double>::max();
+		max_lat = std::numeric_limits<double>::lowest();
+		min_lon = std::numeric_limits<double>::max();
+		max_lon = std::numeric_limits<double>::lowest();
+	}
+
+	Box::Box(double minlat, double maxlat, double minlon, double maxlon)
+	{
+		min_lat = minlat;
+		max_lat = maxlat;
+		min_lon = minlon;
+		max_lon = maxlon;
+	}
+
+	Box::Box(types::Way &way, vector<types::Node> &nodes) : Box(way.refs, nodes)
+	{
+	}
+
+	Box::Box(vector<size_t> &refs, vector<types::Node> &nodes)
+	{
+		min_lat = std::numeric_limits<double>::max();
+		max_lat = std::numeric_limits<double>::lowest();
+		min_lon = std::numeric_limits<double>::max();
+		max_lon = std::numeric_limits<double>::lowest();
+
+		for (size_t i = 0; i < refs.size(); i++)
+		{
+			types::Node &n = nodes[refs[i]];
+			min_lat = n.lat < min_lat ? n.lat : min_lat;
+			max_lat = n.lat > max_lat ? n.lat : max_lat;
+			min_lon = n.lon < min_lon ? n.lon : min_lon;
+			max_lon = n.lon > max_lon ? n.lon : max_lon;
+		}
+	}
+
+	bool Box::IsEmpty()
+	{
+		return min_lat > max_lat || min_lon > max_lon;
+	}
+
+	bool Box::Intersects(Box &other, double margin)
+	{
+		return min_lat - margin <= other.max_lat && other.min_lat <= max_lat + margin &&
+			min_lon - margin <= other.max_lon && other.min_lon <= max_lon + margin;
+	}
+
+	double Box::Gap(Box &other)
+	{
+		double lat = std::fmax(0.0, std::fmax(other.min_lat - max_lat, min_lat - other.max_lat));
+		double lon = std::fmax(0.0, std::fmax(other.min_lon - max_lon, min_lon - other.max_lon));
+
+		return std::sqrt(lat * lat + lon * lon);
+	}
+
+	void Box::Extend(Box &other)
+	{
+		min_lat = other.min_lat < min_lat ? other.min_lat : min_lat;
+		max_lat = other.max_lat > max_lat ? other.max_lat : max_lat;
+		min_lon = other.min_lon < min_lon ? other.min_lon : min_lon;
+		max_lon = other.max_lon > max_lon ? other.max_lon : max_lon;
+	}
+
+	// Grid functions
+	Grid::Grid()
+	{
+		m_minlat = 0.0;
+		m_minlon = 0.0;
+		m_cell_size = 1.0;
+		m_rows = 0;
+		m_cols = 0;
+		m_query = 0;
+		m_cells = vector<vector<size_t>>();
+		m_boxes = vector<spatial::Box>();
+		m_stamp = vector<size_t>();
+	}
+
+	void Grid::Build(vector<spatial::Box> &boxes, double cell_size)
+	{
+		Clear();
+
+		Box extent = Box();
+		for (size_t i = 0; i < boxes.size(); i++)
+		{
+			if (!boxes[i].IsEmpty())
+				extent.Extend(boxes[i]);
+		}
+
+		m_boxes = vector<spatial::Box>(boxes.size(), Box());
+		m_stamp = vector<size_t>(boxes.size(), 0);
+
+		if (extent.IsEmpty())
+			return;
+
+		// Grow the cells if the grid would get too large
+		double height = extent.max_lat - extent.min_lat;
+		double width = extent.max_lon - extent.min_lon;
+		double limit = std::fmax(height, width) / (double)MAX_GRID_DIM;
+		m_cell_size = cell_size > limit ? cell_size : limit;
+		if (m_cell_size <= 0.0)
+			m_cell_size = 1.0;
+
+		m_minlat = extent.min_lat;
+		m_minlon = extent.min_lon;
+		m_rows = (size_t)std::floor(height / m_cell_size) + 1;
+		m_cols = (size_t)std::floor(width / m_cell_size) + 1;
+		m_cells = vector<vector<size_t>>(m_rows * m_cols, vector<size_t>());
+
+		for (size_t i = 0; i < boxes.size(); i++)
+		{
+			if (!boxes[i].IsEmpty())
+				Insert(i, boxes[i]);
+		}
+	}
+
+	void Grid::Insert(size_t index, spatial::Box &box)
+	{
+		if (m_cells.empty() || box.IsEmpty())
+			return;
+
+		if (index >= m_boxes.size())
+		{
+			m_boxes.resize(index + 1, Box());
+			m_stamp.resize(index + 1, 0);
+		}
+
+		// Boxes can only grow, cells registered earlier stay valid
+		m_boxes[index].Extend(box);
+
+		size_t row_start, row_end, col_start, col_end;
+		CellRange(box, 0.0, row_start, row_end, col_start, col_end);
+
+		for (size_t r = row_start; r <= row_end; r++)
+		{
+			for (size_t c = col_start; c <= col_end; c++)
+				m_cells[r * m_cols + c].push_back(index);
+		}
+	}
+
+	void Grid::Clear()
+	{
+		m_rows = 0;
+		m_cols = 0;
+		m_query = 0;
+		m_cells.clear();
+		m_boxes.clear();
+		m_stamp.clear();
+	}
+
+	bool Grid::Empty()
+	{
+		return m_cells.empty();
+	}
+
+	spatial::Box &Grid::GetBox(size_t index)
+	{
+		return m_boxes.at(index);
+	}
+
+	void Grid::Query(spatial::Box &box, double margin, vector<size_t> &result)
+	{
+		result.clear();
+
+		if (m_cells.empty() || box.IsEmpty())
+			return;
+
+		m_query++;
+
+		size_t row_start, row_end, col_start, col_end;
+		CellRange(box, margin, row_start, row_end, col_start, col_end);
+
+		for (size_t r = row_start; r <= row_end; r++)
+		{
+			for (size_t c = col_start; c <= col_end; c++)
+			{
+				vector<size_t> &cell = m_cells[r * m_cols + c];
+				for (size_t i = 0; i < cell.size(); i++)
+				{
+					if (m_stamp[cell[i]] != m_query && m_boxes[cell[i]].Intersects(box, margin))
+						result.push_back(cell[i]);
+
+					m_stamp[cell[i]] = m_query;
+				}
+			}
+		}
+
+		std::sort(result.begin(), result.end());
+	}
+
+	void Grid::CellRange(spatial::Box &box, double margin, size_t &row_start, size_t &row_end, size_t &col_start, size_t &col_end)
+	{
+		// Clamp to the grid, everything outside of it lies in the border cells
+		double rs = std::floor((box.min_lat - margin - m_minlat) / m_cell_size);
+		double re = std::floor((box.max_lat + margin - m_minlat) / m_cell_size);
+		double cs = std::floor((box.min_lon - margin - m_minlon) / m_cell_size);
+		double ce = std::floor((box.max_lon + margin - m_minlon) / m_cell_size);
+
+		row_start = rs < 0.0 ? 0 : (rs >= (double)m_rows ? m_rows - 1 : (size_t)rs);
+		row_end = re < 0.0 ? 0 : (re >= (double)m_rows ? m_rows - 1 : (size_t)re);
+		col_start = cs < 0.0 ? 0 : (cs >= (double)m_cols ? m_cols - 1 : (size_t)cs);
+		col_end = ce < 0.0 ? 0 : (ce >= (double)m_cols ? m_cols - 1 : (size_t)ce);
+	}
+}
@@ -0,0 +1,102 @@
+#include "..\\header\\threadpool.h"
+
+namespace threadpool
+{
+	ThreadPool::ThreadPool(size_t threads)
+	{
+		if (threads == 0)
+			threads = std::thread::hardware_concurrency();
+
+		m_next = m_count = m_finished = m_generation = 0;
+		m_stop = false;
+
+		// The calling thread is one of the workers
+		for (size_t i = 1; i < threads; i++)
+			m_workers.push_back(std::thread(&ThreadPool::Work, this));
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_start.notify_all();
+
+		for (size_t i = 0; i < m_workers.size(); i++)
+			m_workers[i].join();
+	}
+
+	size_t ThreadPool::Size()
+	{
+		return m_workers.size() + 1;
+	}
+
+	void ThreadPool::ForEach(size_t count, std::function<void(size_t)> task)
+	{
+		if (count == 0)
+			return;
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_task = task;
+		m_next = 0;
+		m_count = count;
+		m_finished = 0;
+		m_generation++;
+		m_start.notify_all();
+
+		RunTasks(lock);
+
+		m_done.wait(lock, [this] { return m_finished == m_count; });
+		m_task = nullptr;
+
+		// The first exception of any task is passed on to the caller
+		if (m_error)
+		{
+			std::exception_ptr error = m_error;
+			m_error = nullptr;
+			std::rethrow_exception(error);
+		}
+	}
+
+	void ThreadPool::Work()
+	{
+		size_t seen = 0;
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		while (true)
+		{
+			m_start.wait(lock, [this, seen] { return m_stop || m_generation != seen; });
+			if (m_stop)
+				return;
+
+			seen = m_generation;
+			RunTasks(lock);
+		}
+	}
+
+	// Claims indices until none are left, the lock is only released while a task runs
+	void ThreadPool::RunTasks(std::unique_lock<std::mutex> &lock)
+	{
+		while (m_next < m_count)
+		{
+			size_t index = m_next++;
+
+			lock.unlock();
+			try
+			{
+				m_task(index);
+				lock.lock();
+			}
+			catch (...)
+			{
+				lock.lock();
+				if (!m_error)
+					m_error = std::current_exception();
+			}
+
+			if (++m_finished == m_count)
+				m_done.notify_all();
+		}
+	}
+}
@@ -118,12 +118,18 @@ namespace types
 	{
 		id = other.id;
 		refs = std::vector<size_t>(other.refs.begin(), other.refs.end());
+		importance = std::vector<double>(other.importance.begin(), other.importance.end());
+		ranked_size = other.ranked_size;
+		ranking = other.ranking;
 		type = other.type;
 	}
 
 	Way::Way(vector<size_t> &references, long long i, types::Type way_type)
 	{
 		refs = references;
+		importance = vector<double>();
+		ranked_size = 0;
+		ranking = douglas_peucker;
 		id = i;
 		type = way_type;
 	}
@@ -172,6 +178,73 @@ namespace types
 		// Push last point if it was erased
 		if (IsArea() && refs.back() != refs[0])
 			refs.push_back(refs[0]);
+
+		if (importance.size() != refs.size())
+			Unrank();
+	}
+
+	bool Way::IsRanked()
+	{
+		return !refs.empty() && importance.size() == refs.size();
+	}
+
+	void Way::Unrank()
+	{
+		importance.clear();
+		ranked_size = 0;
+	}
+
+	void Way::Filter(double threshold)
+	{
+		size_t at = 0;
+		for (size_t i = 0; i < refs.size(); i++)
+		{
+			if (importance[i] > threshold)
+			{
+				refs[at] = refs[i];
+				importance[at] = importance[i];
+				at++;
+			}
+		}
+		refs.resize(at);
+		importance.resize(at);
+	}
+
+	void Way::FilterCount(size_t keep)
+	{
+		// First and last point always stay
+		if (keep < 2)
+			keep = 2;
+
+		if (keep >= refs.size())
+			return;
+
+		vector<double> sorted = vector<double>(importance.begin(), importance.end());
+		std::nth_element(sorted.begin(), sorted.begin() + (refs.size() - keep), sorted.end());
+		double threshold = sorted[refs.size() - keep];
+
+		// Vertices whose importance equals the threshold are kept from front to back
+		size_t ties = keep - std::count_if(importance.begin(), importance.end(), [threshold](double d) { return d > threshold; });
+
+		size_t at = 0;
+		for (size_t i = 0; i < refs.size(); i++)
+		{
+			bool keep_vertex = importance[i] > threshold;
+			if (!keep_vertex && importance[i] == threshold && ties > 0)
+			{
+				keep_vertex = true;
+				ties--;
+			}
+
+			if (keep_vertex)
+			{
+				refs[at] = refs[i];
+				importance[at] = importance[i];
+				at++;
+			}
+		}
+		refs.resize(at);
+		importance.resize(at);
 	}
 
 	bool Way::IsInsideTile(types::Tile & t, vector<types::Node>& nodes, types::Sorting sort)
@@ -636,7 +709,7 @@ namespace types
 
 	int Relation::AtLat(types::Tile &t, vector<types::Node> &nodes, vector<types::Way> &ways, vector<types::Relation> &relations, types::Sorting sort)
 	{
-		if (sort == first_node)
+		if (sort == first_node || sort == clip)
 		{
 			switch (member_types[0])
 			{
@@ -684,7 +757,7 @@ namespace types
 
 	int Relation::AtLon(types::Tile &t, vector<types::Node>& nodes, vector<types::Way>& ways, vector<types::Relation>& relations, types::Sorting sort)
 	{
-		if (sort == first_node)
+		if (sort == first_node || sort == clip)
 		{
 			switch (member_types[0])
 			{
@@ -951,6 +1024,31 @@ namespace types
 			   std::all_of(relations.begin(), relations.end(), [](RelationX &r) { return r.IsComplete(); });
 	}
 
+	// PointGroup functions
+	PointGroup::PointGroup() : PointGroup(none)
+	{
+	}
+
+	PointGroup::PointGroup(types::Type t)
+	{
+		type = t;
+		lats = vector<double>();
+		lons = vector<double>();
+		weights = vector<unsigned int>();
+	}
+
+	void PointGroup::Add(double lat, double lon, unsigned int weight)
+	{
+		lats.push_back(lat);
+		lons.push_back(lon);
+		weights.push_back(weight);
+	}
+
+	size_t PointGroup::Size()
+	{
+		return lats.size();
+	}
+
 	// Tile functions
 	Tile::Tile()
 	{
@@ -965,8 +1063,23 @@ namespace types
 		max_lon = maxlon;
 		way_refs = vector<size_t>();
 		wayx_refs = vector<size_t>();
-		solo_refs = vector<size_t>();
+		point_groups = vector<PointGroup>();
 		relation_refs = vector<size_t>();
 		relationx_refs = vector<size_t>();
+		shared_way_refs = vector<size_t>();
+		shared_relation_refs = vector<size_t>();
+		piece_refs = vector<size_t>();
+	}
+
+	void Tile::AddPoint(types::Type t, double lat, double lon, unsigned int weight)
+	{
+		auto it = std::find_if(point_groups.begin(), point_groups.end(), [t](PointGroup &g) { return g.type == t; });
+		if (it == point_groups.end())
+		{
+			point_groups.push_back(PointGroup(t));
+			it = point_groups.end() - 1;
+		}
+
+		it->Add(lat, lon, weight);
 	}
 }
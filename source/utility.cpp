@@ -202,6 +202,9 @@ void utility::PrintInputFormat()
 	cout << "*                                                                                          *" << endl;
 	cout << "*  in=my_input.pbf [--debug] [out=out_dir] [sort=f] [line=d] [log=3]                       *" << endl;
 	cout << "*                  [lod=1-1-1-1-1-1-1-1-1-1-1-1-1-1-1-1]                                   *" << endl;
+	cout << "*                  [simplify=r-r-r-r-r-r-d-d-d-d-d-d-d-d-d-d]                              *" << endl;
+	cout << "*                  [share=0] [raster=0] [hull=0]                                           *" << endl;
+	cout << "*                  [compress=0-0-0-0-0-0-0-0-0-0-0-0-0-0-0-0] [importance=t]               *" << endl;
 	cout << "*                                                                                          *" << endl;
 	cout << "*  Everything in square brackets is optional, if you don't use those                       *" << endl;
 	cout << "*  parameters the default input is as follows:                                             *" << endl;
@@ -220,8 +223,25 @@ void utility::PrintInputFormat()
 	cout << "*  Values for sort: f|F -> Sort by first element                                           *" << endl;
 	cout << "*                   m|M -> Sort by majority                                                *" << endl;
 	cout << "*                   s|S -> Divide elements that span across tiles                          *" << endl;
+	cout << "*                   c|C -> Clip elements into one piece per tile they touch                *" << endl;
 	cout << "*  Values for line: d|D -> Do line simplification using Douglas-Peucker algorithm          *" << endl;
 	cout << "*                   v|V -> Do line simplification using Visvalingam-Whyatt algorithm       *" << endl;
+	cout << "*  Values for simplify: Line simplification per LoD (starting at LoD 0), by default        *" << endl;
+	cout << "*                   radial distance up to LoD 5 and the line algorithm above after that    *" << endl;
+	cout << "*                   d|D -> Douglas-Peucker        v|V -> Visvalingam-Whyatt                *" << endl;
+	cout << "*                   r|R -> Radial distance        w|W -> Reumann-Witkam                    *" << endl;
+	cout << "*                   g|G -> Grid snapping                                                   *" << endl;
+	cout << "*  Values for share: Minimum number of tiles an object has to span to be written once      *" << endl;
+	cout << "*                   per LoD into a shared file that its tiles reference, 0 turns it off    *" << endl;
+	cout << "*  Values for raster: Grid cells per tile side used to rasterize and re-trace landcover    *" << endl;
+	cout << "*                   areas at LoDs 0-2, 0 turns it off                                      *" << endl;
+	cout << "*  Values for hull:  Number of coarsest LoDs at which small areas are replaced by their    *" << endl;
+	cout << "*                   convex hull, 0 turns it off                                            *" << endl;
+	cout << "*  Values for compress: zlib level per LoD (starting at LoD 0) used to compress every      *" << endl;
+	cout << "*                   tile on its own, 0 stores the tiles uncompressed                       *" << endl;
+	cout << "*  Values for importance: Order of the objects in a tile, written in 4 tiers so readers    *" << endl;
+	cout << "*                   can stop early and still have the most important objects               *" << endl;
+	cout << "*                   t|T -> Type priority        a|A -> Area          v|V -> Vertex count   *" << endl;
 	cout << "*                                                                                          *" << endl;
 	cout << "*  The lod parameter sets the root number of tiles per LOD (starting at LoD 0              *" << endl;
 	cout << "*  up to LoD 15) you wish to have.                                                         *" << endl;
@@ -251,7 +271,7 @@ void utility::PrintInputFormat()
 	cout << "**********************************OSMConverter-Application**********************************" << endl;
 }
 
-void utility::PrintUserInput(string in, string out, bool debug, bool line, logging::LogLvl log, size_t lods[16], types::Sorting s)
+void utility::PrintUserInput(string in, string out, bool debug, bool line, logging::LogLvl log, size_t lods[16], types::Sorting s, types::Simplification simplify[16], size_t share, size_t raster, size_t hull, int compress[16], types::Importance importance)
 {
 	string sort, loglvl;
 
@@ -260,6 +280,7 @@ void utility::PrintUserInput(string in, string out, bool debug, bool line, loggi
 		case types::Sorting::first_node: sort.assign("First Node"); break;
 		case types::Sorting::most_nodes: sort.assign("Most Node"); break;
 		case types::Sorting::subdivide: sort.assign("Subdivide"); break;
+		case types::Sorting::clip: sort.assign("Clip"); break;
 	}
 
 	switch (log)
@@ -276,16 +297,45 @@ void utility::PrintUserInput(string in, string out, bool debug, bool line, loggi
 	cout << "\t\tline simplification: " + (line ? string("Douglas-Peucker") : string("Visvalingam-Whyatt")) << endl;
 	cout << "\t\tlog level: " + loglvl << endl;
 	cout << "\t\tsorting: " + sort << endl;
+	cout << "\t\tshared objects: " + (share > 0 ? "spanning at least " + to_string(share) + " tiles" : string("off")) << endl;
+	cout << "\t\traster generalization: " + (raster > 0 ? to_string(raster) + " cells per tile side" : string("off")) << endl;
+	cout << "\t\tobject importance: " + ImportanceToString(importance) << endl;
+	cout << "\t\tconvex hulls: " + (hull > 0 ? "LoDs 0 to " + to_string(hull - 1) : string("off")) << endl;
 	cout << "\t\tLoDs: " << endl;
 	for (int i = 0; i < 16; i++)
 	{
-		cout << "\t\t\tLoD " + to_string(i) + " : " + to_string(lods[i]) + " x " + to_string(lods[i]) << endl;
+		cout << "\t\t\tLoD " + to_string(i) + " : " + to_string(lods[i]) + " x " + to_string(lods[i]) + " (" + SimplificationToString(simplify[i]) +
+			(compress[i] > 0 ? ", zlib " + to_string(compress[i]) : string()) + ")" << endl;
 	}
 }
 
-bool utility::CheckInput(string &test, string &in, string &out, bool &de, bool &l, logging::LogLvl &log, size_t (&lods)[16], types::Sorting &s)
+string utility::ImportanceToString(types::Importance importance)
 {
-	bool found_param[7] = { false };
+	switch (importance)
+	{
+		case types::Importance::by_type: return "Type Priority"; break;
+		case types::Importance::by_area: return "Area"; break;
+		case types::Importance::by_vertices: return "Vertex Count"; break;
+	}
+	return "Unknown";
+}
+
+string utility::SimplificationToString(types::Simplification simplify)
+{
+	switch (simplify)
+	{
+		case types::Simplification::douglas_peucker: return "Douglas-Peucker"; break;
+		case types::Simplification::visvalingam_whyatt: return "Visvalingam-Whyatt"; break;
+		case types::Simplification::radial_distance: return "Radial Distance"; break;
+		case types::Simplification::reumann_witkam: return "Reumann-Witkam"; break;
+		case types::Simplification::grid_snap: return "Grid Snapping"; break;
+	}
+	return "Unknown";
+}
+
+bool utility::CheckInput(string &test, string &in, string &out, bool &de, bool &l, logging::LogLvl &log, size_t (&lods)[16], types::Sorting &s, types::Simplification (&simplify)[16], size_t &share, size_t &raster, size_t &hull, int (&compress)[16], types::Importance &importance)
+{
+	bool found_param[13] = { false };
 	short limit = OccurencesOf(test, ' ');
 	string::size_type found;
 
@@ -474,12 +524,137 @@ bool utility::CheckInput(string &test, string &in, string &out, bool &de, bool &
 			{
 				s = types::Sorting::first_node;
 			}
+			else if (test[found + 5] == 'c' || test[found + 5] == 'C')
+			{
+				s = types::Sorting::clip;
+			}
 			else
 			{
 				cout << "Invalid sorting paramter value" << endl;
 				return false;
 			}
 		}
+		else if (!found_param[7] && (found = test.find("simplify=")) != string::npos)
+		{
+			found_param[7] = true;
+			size_t at = found + 9;
+
+			// One letter per LoD separated by '-'
+			for (short i = 0; i < 16; i++, at += 2)
+			{
+				switch (at < test.length() ? test[at] : ' ')
+				{
+					case 'd': case 'D': simplify[i] = types::Simplification::douglas_peucker; break;
+					case 'v': case 'V': simplify[i] = types::Simplification::visvalingam_whyatt; break;
+					case 'r': case 'R': simplify[i] = types::Simplification::radial_distance; break;
+					case 'w': case 'W': simplify[i] = types::Simplification::reumann_witkam; break;
+					case 'g': case 'G': simplify[i] = types::Simplification::grid_snap; break;
+					default:
+						cout << "Invalid simplify parameter value for LoD " << i << endl;
+						return false;
+				}
+			}
+		}
+		else if (!found_param[8] && (found = test.find("share=")) != string::npos)
+		{
+			found_param[8] = true;
+			try
+			{
+				share = stoul(test.substr(found + 6, test.find(" ", found) - (found + 6)), nullptr, 10);
+			}
+			catch (invalid_argument)
+			{
+				cout << "Argument of share parameter could not be convertred to an integer!" << endl;
+				return false;
+			}
+			catch (out_of_range)
+			{
+				cout << "Argument of share parameter was out of integer range!" << endl;
+				return false;
+			}
+		}
+		else if (!found_param[9] && (found = test.find("raster=")) != string::npos)
+		{
+			found_param[9] = true;
+			try
+			{
+				raster = stoul(test.substr(found + 7, test.find(" ", found) - (found + 7)), nullptr, 10);
+			}
+			catch (invalid_argument)
+			{
+				cout << "Argument of raster parameter could not be convertred to an integer!" << endl;
+				return false;
+			}
+			catch (out_of_range)
+			{
+				cout << "Argument of raster parameter was out of integer range!" << endl;
+				return false;
+			}
+		}
+		else if (!found_param[10] && (found = test.find("hull=")) != string::npos)
+		{
+			found_param[10] = true;
+			try
+			{
+				hull = stoul(test.substr(found + 5, test.find(" ", found) - (found + 5)), nullptr, 10);
+			}
+			catch (invalid_argument)
+			{
+				cout << "Argument of hull parameter could not be convertred to an integer!" << endl;
+				return false;
+			}
+			catch (out_of_range)
+			{
+				cout << "Argument of hull parameter was out of integer range!" << endl;
+				return false;
+			}
+
+			if (hull > 16)
+			{
+				cout << "Argument of hull parameter can not be greater than the number of LoDs (16)!" << endl;
+				return false;
+			}
+		}
+		else if (!found_param[11] && (found = test.find("compress=")) != string::npos)
+		{
+			found_param[11] = true;
+			size_t at = found + 9;
+
+			// One zlib level per LoD separated by '-'
+			for (short i = 0; i < 16; i++, at += 2)
+			{
+				char c = at < test.length() ? test[at] : ' ';
+				if (c < '0' || c > '9')
+				{
+					cout << "Invalid compress parameter value for LoD " << i << endl;
+					return false;
+				}
+
+				compress[i] = c - '0';
+			}
+		}
+		else if (!found_param[12] && (found = test.find("importance=")) != string::npos)
+		{
+			found_param[12] = true;
+
+			if (test[found + 11] == 't' || test[found + 11] == 'T')
+			{
+				importance = types::Importance::by_type;
+			}
+			else if (test[found + 11] == 'a' || test[found + 11] == 'A')
+			{
+				importance = types::Importance::by_area;
+			}
+			else if (test[found + 11] == 'v' || test[found + 11] == 'V')
+			{
+				importance = types::Importance::by_vertices;
+			}
+			else
+			{
+				cout << "Invalid importance paramter value" << endl;
+				return false;
+			}
+		}
 		else if (!found_param[6] && (found = test.find("log=")) != string::npos)
 		{
 			found_param[6] = true;
@@ -547,10 +722,39 @@ bool utility::CheckInput(string &test, string &in, string &out, bool &de, bool &
 	if (!found_param[6])
 		log = logging::LogLvl::error;
 
+	if (!found_param[8])
+		share = 0;
+
+	if (!found_param[9])
+		raster = 0;
+
+	if (!found_param[10])
+		hull = 0;
+
+	if (!found_param[11])
+	{
+		for (short i = 0; i < 16; i++)
+			compress[i] = 0;
+	}
+
+	if (!found_param[12])
+		importance = types::Importance::by_type;
+
+	if (!found_param[7])
+	{
+		for (short i = 0; i < 16; i++)
+		{
+			if (i <= 5)
+				simplify[i] = types::Simplification::radial_distance;
+			else
+				simplify[i] = l ? types::Simplification::douglas_peucker : types::Simplification::visvalingam_whyatt;
+		}
+	}
+
 	return true;
 }
 
-void utility::GetUserInput(string &in, string &out, bool &de, bool &l, logging::LogLvl &log, size_t (&lods)[16], types::Sorting &s)
+void utility::GetUserInput(string &in, string &out, bool &de, bool &l, logging::LogLvl &log, size_t (&lods)[16], types::Sorting &s, types::Simplification (&simplify)[16], size_t &share, size_t &raster, size_t &hull, int (&compress)[16], types::Importance &importance)
 {
 	string input;
 	bool valid = false;
@@ -562,7 +766,7 @@ void utility::GetUserInput(string &in, string &out, bool &de, bool &l, logging::
 
 		// Only check user input if it is not empty
 		if (!input.empty())
-			valid = CheckInput(input, in, out, de, l, log, lods, s);
+			valid = CheckInput(input, in, out, de, l, log, lods, s, simplify, share, raster, hull, compress, importance);
 
 	} while (!valid);
 }